@@ -4,6 +4,28 @@
 #include <map>
 #include <algorithm>
 #include <iomanip>
+#include <sstream>
+#include <unordered_map>
+#include <queue>
+#include <cstdint>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <functional>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 
 using namespace std;
 
@@ -12,196 +34,1175 @@ class User;
 class Group;
 class ExpenseManager;
 
+// Dense index handed out by IdInterner
+using UserIndex = uint32_t;
+
+// Interns string ids ("user7") into dense 32-bit indices so hot paths can use flat arrays.
+// Thread-safe: string -> index lookups take a shared lock on one of SHARDS maps, and the
+// index -> string table is allocated in chunks that never move once published.
+class IdInterner {
+private:
+    static const size_t SHARDS = 16;
+    static const uint32_t CHUNK_BITS = 16;
+    static const uint32_t CHUNK_MASK = (1u << CHUNK_BITS) - 1;
+    static const size_t MAX_CHUNKS = 1u << (32 - CHUNK_BITS);
+
+    struct alignas(64) Shard {
+        mutable shared_mutex mutex;
+        unordered_map<string, uint32_t> indexOf;
+    };
+    Shard shards[SHARDS];
+    unique_ptr<atomic<string*>[]> chunks; // index >> CHUNK_BITS -> ids of that chunk
+    atomic<uint32_t> count{0};
+    mutex chunkMutex;
+
+    Shard& shardOf(const string& id) const {
+        return const_cast<Shard&>(shards[hash<string>()(id) % SHARDS]);
+    }
+
+public:
+    static constexpr uint32_t NOT_FOUND = UINT32_MAX;
+
+    IdInterner() : chunks(new atomic<string*>[MAX_CHUNKS]()) {}
+
+    ~IdInterner() {
+        for (size_t i = 0; i < MAX_CHUNKS; i++) {
+            delete[] chunks[i].load();
+        }
+    }
+
+    uint32_t intern(const string& id) {
+        Shard& shard = shardOf(id);
+        unique_lock<shared_mutex> lock(shard.mutex);
+        auto it = shard.indexOf.find(id);
+        if (it != shard.indexOf.end()) {
+            return it->second;
+        }
+        uint32_t index = count.fetch_add(1);
+        atomic<string*>& chunk = chunks[index >> CHUNK_BITS];
+        if (!chunk.load(memory_order_acquire)) {
+            lock_guard<mutex> allocating(chunkMutex);
+            if (!chunk.load(memory_order_relaxed)) {
+                chunk.store(new string[CHUNK_MASK + 1], memory_order_release);
+            }
+        }
+        chunk.load(memory_order_acquire)[index & CHUNK_MASK] = id;
+        shard.indexOf.emplace(id, index);
+        return index;
+    }
+
+    uint32_t find(const string& id) const {
+        Shard& shard = shardOf(id);
+        shared_lock<shared_mutex> lock(shard.mutex);
+        auto it = shard.indexOf.find(id);
+        return (it != shard.indexOf.end()) ? it->second : NOT_FOUND;
+    }
+
+    // The index must have come from intern()/find() (or a User), which orders the read
+    const string& idOf(uint32_t index) const {
+        return chunks[index >> CHUNK_BITS].load(memory_order_acquire)[index & CHUNK_MASK];
+    }
+
+    size_t size() const {
+        return count.load();
+    }
+
+    // Shared interner for User::userId
+    static IdInterner& users() {
+        static IdInterner instance;
+        return instance;
+    }
+};
+
+// String-keyed registry split into independently locked shards, so threads looking up
+// different keys rarely contend on the same lock
+template <typename V>
+class ShardedMap {
+private:
+    static const size_t SHARDS = 16;
+
+    struct alignas(64) Shard {
+        mutable shared_mutex mutex;
+        unordered_map<string, V> entries;
+    };
+    Shard shards[SHARDS];
+
+    Shard& shardOf(const string& key) const {
+        return const_cast<Shard&>(shards[hash<string>()(key) % SHARDS]);
+    }
+
+public:
+    // V() if absent
+    V find(const string& key) const {
+        Shard& shard = shardOf(key);
+        shared_lock<shared_mutex> lock(shard.mutex);
+        auto it = shard.entries.find(key);
+        return (it != shard.entries.end()) ? it->second : V();
+    }
+
+    void insert(const string& key, V value) {
+        Shard& shard = shardOf(key);
+        unique_lock<shared_mutex> lock(shard.mutex);
+        shard.entries[key] = value;
+    }
+
+    // Visits every value, one shard at a time
+    template <typename F>
+    void forEach(F f) const {
+        for (const Shard& shard : shards) {
+            shared_lock<shared_mutex> lock(shard.mutex);
+            for (const auto& entry : shard.entries) {
+                f(entry.second);
+            }
+        }
+    }
+};
+
+// Open-addressing hash map keyed by a dense index (linear probing, backward-shift delete).
+// Keys and values live in two flat arrays, so a lookup touches one or two cache lines.
+// UINT32_MAX (IdInterner::NOT_FOUND) marks empty slots and is never a key.
+template <typename V>
+class FlatIndexMap {
+private:
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+    vector<uint32_t> keys;
+    vector<V> values;
+    size_t count = 0;
+    int shift = 32;
+
+    size_t home(uint32_t key) const {
+        return (uint32_t)(key * 2654435769u) >> shift; // Fibonacci hashing
+    }
+
+    size_t mask() const {
+        return keys.size() - 1;
+    }
+
+    void grow() {
+        vector<uint32_t> oldKeys = move(keys);
+        vector<V> oldValues = move(values);
+        size_t capacity = oldKeys.empty() ? 8 : oldKeys.size() * 2;
+        keys.assign(capacity, EMPTY);
+        values.assign(capacity, V());
+        shift = 32 - __builtin_ctzll(capacity);
+        count = 0;
+        for (size_t i = 0; i < oldKeys.size(); i++) {
+            if (oldKeys[i] != EMPTY) {
+                (*this)[oldKeys[i]] = oldValues[i];
+            }
+        }
+    }
+
+public:
+    V* find(uint32_t key) {
+        if (keys.empty() || key == EMPTY) return nullptr;
+        for (size_t i = home(key); ; i = (i + 1) & mask()) {
+            if (keys[i] == key) return &values[i];
+            if (keys[i] == EMPTY) return nullptr;
+        }
+    }
+
+    const V* find(uint32_t key) const {
+        return const_cast<FlatIndexMap*>(this)->find(key);
+    }
+
+    // Inserts a default value if the key is absent
+    V& operator[](uint32_t key) {
+        if (key == EMPTY) {
+            throw runtime_error("FlatIndexMap: UINT32_MAX is not a valid key");
+        }
+        if ((count + 1) * 10 > keys.size() * 7) {
+            grow();
+        }
+        size_t i = home(key);
+        while (keys[i] != EMPTY && keys[i] != key) {
+            i = (i + 1) & mask();
+        }
+        if (keys[i] == EMPTY) {
+            keys[i] = key;
+            values[i] = V();
+            count++;
+        }
+        return values[i];
+    }
+
+    bool erase(uint32_t key) {
+        if (keys.empty() || key == EMPTY) return false;
+        size_t i = home(key);
+        while (keys[i] != key) {
+            if (keys[i] == EMPTY) return false;
+            i = (i + 1) & mask();
+        }
+        // Shift later entries of the probe chain back so no tombstones are needed
+        for (size_t j = (i + 1) & mask(); keys[j] != EMPTY; j = (j + 1) & mask()) {
+            size_t h = home(keys[j]);
+            if (((j - h) & mask()) >= ((j - i) & mask())) {
+                keys[i] = keys[j];
+                values[i] = values[j];
+                i = j;
+            }
+        }
+        keys[i] = EMPTY;
+        values[i] = V();
+        count--;
+        return true;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    // Every slot's value, including empty slots (which always hold V()), so a
+    // reduction can run over the whole array without checking keys
+    const V* rawValues() const {
+        return values.data();
+    }
+
+    size_t capacity() const {
+        return values.size();
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    template <typename F>
+    void forEach(F f) const {
+        for (size_t i = 0; i < keys.size(); i++) {
+            if (keys[i] != EMPTY) {
+                f(keys[i], values[i]);
+            }
+        }
+    }
+};
+
+// Money in integer minor units (paise), so balances add up exactly and zero means settled
+class Money {
+public:
+    int64_t paise;
+
+    Money() : paise(0) {}
+    explicit Money(int64_t paise) : paise(paise) {}
+
+    static Money fromRupees(double rupees) {
+        return Money(llround(rupees * 100));
+    }
+
+    double toRupees() const {
+        return paise / 100.0;
+    }
+
+    bool isZero() const { return paise == 0; }
+    Money abs() const { return Money(paise < 0 ? -paise : paise); }
+
+    Money operator+(Money other) const { return Money(paise + other.paise); }
+    Money operator-(Money other) const { return Money(paise - other.paise); }
+    Money operator-() const { return Money(-paise); }
+    Money& operator+=(Money other) { paise += other.paise; return *this; }
+    Money& operator-=(Money other) { paise -= other.paise; return *this; }
+
+    bool operator==(Money other) const { return paise == other.paise; }
+    bool operator!=(Money other) const { return paise != other.paise; }
+    bool operator<(Money other) const { return paise < other.paise; }
+    bool operator>(Money other) const { return paise > other.paise; }
+    bool operator<=(Money other) const { return paise <= other.paise; }
+    bool operator>=(Money other) const { return paise >= other.paise; }
+
+    // "1234.05" - independent of the stream's fixed/setprecision state
+    string toString() const {
+        int64_t whole = (paise < 0 ? -paise : paise);
+        string fraction = to_string(whole % 100);
+        return (paise < 0 ? "-" : "") + to_string(whole / 100) + "." + (fraction.size() < 2 ? "0" : "") + fraction;
+    }
+};
+
+ostream& operator<<(ostream& out, Money money) {
+    return out << money.toString();
+}
+
+// Branchless reductions over flat arrays of paise: no data-dependent branches, so the
+// compiler can vectorize them
+int64_t sumPositive(const Money* values, size_t count) {
+    int64_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += max<int64_t>(values[i].paise, 0);
+    }
+    return total;
+}
+
+int64_t sumNegative(const Money* values, size_t count) { // as a positive amount
+    int64_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += max<int64_t>(-values[i].paise, 0);
+    }
+    return total;
+}
+
 enum class SplitType {
     EQUAL,
     EXACT,
     PERCENTAGE
 };
 
+// One user's share of an expense, keyed by interned user index so splits are
+// copied and stored without any string allocation
 class Split {
 public:
-    string userId;
-    double amount;
-    
-    Split(const string& userId, double amount) {
-        this->userId = userId;
+    UserIndex user;
+    Money amount;
+
+    Split(UserIndex user, Money amount) : user(user), amount(amount) {}
+
+    Split(const string& userId, Money amount) {
+        this->user = IdInterner::users().intern(userId);
         this->amount = amount;
     }
+
+    const string& userId() const {
+        return IdInterner::users().idOf(user);
+    }
 };
 
 // Observer Pattern - Notification interface
 class Observer {
 public:
     virtual void update(const string& message) = 0;
+
+    // Several queued notifications delivered at once (used by NotificationDispatcher)
+    virtual void updateBatch(const vector<const string*>& messages) {
+        for (const string* message : messages) {
+            update(*message);
+        }
+    }
+};
+
+// What publish() does when the notification queue is full
+enum class BackPressure {
+    BLOCK,  // producer waits until the dispatcher frees a slot
+    DROP    // notification is discarded and counted in droppedCount()
+};
+
+struct Notification {
+    shared_ptr<const vector<Observer*>> recipients;
+    string message;
+};
+
+// Bounded multi-producer / single-consumer ring buffer.
+// Each cell carries a sequence number telling producers and the consumer whose turn it is.
+template <typename T>
+class MpscRingBuffer {
+private:
+    struct Cell {
+        atomic<size_t> sequence;
+        T value;
+    };
+    unique_ptr<Cell[]> cells;
+    size_t mask;
+    alignas(64) atomic<size_t> tail;   // next slot to claim (producers)
+    alignas(64) size_t head;           // next slot to read (consumer only)
+
+public:
+    explicit MpscRingBuffer(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        cells.reset(new Cell[size]);
+        for (size_t i = 0; i < size; i++) {
+            cells[i].sequence.store(i, memory_order_relaxed);
+        }
+        mask = size - 1;
+        tail.store(0, memory_order_relaxed);
+        head = 0;
+    }
+
+    // Moves from value only on success
+    bool tryPush(T& value) {
+        size_t pos = tail.load(memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells[pos & mask];
+            intptr_t diff = (intptr_t)cell.sequence.load(memory_order_acquire) - (intptr_t)pos;
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                    cell.value = move(value);
+                    cell.sequence.store(pos + 1, memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // full
+            } else {
+                pos = tail.load(memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryPop(T& out) {
+        Cell& cell = cells[head & mask];
+        if (cell.sequence.load(memory_order_acquire) != head + 1) {
+            return false; // empty
+        }
+        out = move(cell.value);
+        cell.sequence.store(head + mask + 1, memory_order_release);
+        head++;
+        return true;
+    }
+
+    bool hasItem() const {
+        return cells[head & mask].sequence.load(memory_order_acquire) == head + 1;
+    }
+};
+
+// Delivers notifications on a background thread so publishers never wait on observer I/O.
+// Each drained batch is regrouped per observer and handed over with one updateBatch call.
+class NotificationDispatcher {
+private:
+    static const size_t MAX_BATCH = 256;
+
+    MpscRingBuffer<Notification> queue;
+    BackPressure policy;
+    atomic<bool> running;
+    atomic<bool> sleeping;
+    atomic<uint64_t> accepted;
+    atomic<uint64_t> delivered;
+    atomic<uint64_t> dropped;
+    mutex wakeMutex;
+    condition_variable wake;
+    thread worker;
+
+    void wakeWorker() {
+        if (sleeping.load()) {
+            lock_guard<mutex> lock(wakeMutex);
+            wake.notify_one();
+        }
+    }
+
+    void deliver(vector<Notification>& batch) {
+        unordered_map<Observer*, size_t> slotOf;
+        vector<pair<Observer*, vector<const string*>>> perObserver;
+        for (const Notification& notification : batch) {
+            for (Observer* observer : *notification.recipients) {
+                auto inserted = slotOf.insert({observer, perObserver.size()});
+                if (inserted.second) {
+                    perObserver.push_back({observer, vector<const string*>()});
+                }
+                perObserver[inserted.first->second].second.push_back(&notification.message);
+            }
+        }
+        for (auto& entry : perObserver) {
+            entry.first->updateBatch(entry.second);
+        }
+    }
+
+    void run() {
+        vector<Notification> batch;
+        Notification notification;
+        for (;;) {
+            while (batch.size() < MAX_BATCH && queue.tryPop(notification)) {
+                batch.push_back(move(notification));
+            }
+            if (!batch.empty()) {
+                deliver(batch);
+                delivered += batch.size();
+                batch.clear();
+                continue;
+            }
+            if (!running.load()) {
+                return; // queue is drained
+            }
+            unique_lock<mutex> lock(wakeMutex);
+            sleeping.store(true);
+            wake.wait_for(lock, chrono::milliseconds(1), [&] { return queue.hasItem() || !running.load(); });
+            sleeping.store(false);
+        }
+    }
+
+public:
+    NotificationDispatcher(size_t capacity = 4096, BackPressure policy = BackPressure::BLOCK)
+        : queue(capacity), policy(policy), running(true), sleeping(false),
+          accepted(0), delivered(0), dropped(0) {
+        worker = thread(&NotificationDispatcher::run, this);
+    }
+
+    ~NotificationDispatcher() {
+        running.store(false);
+        {
+            lock_guard<mutex> lock(wakeMutex);
+            wake.notify_one();
+        }
+        worker.join();
+    }
+
+    // O(1) for the caller regardless of how many recipients there are
+    bool publish(const shared_ptr<const vector<Observer*>>& recipients, const string& message) {
+        Notification notification{recipients, message};
+        while (!queue.tryPush(notification)) {
+            if (policy == BackPressure::DROP) {
+                dropped++;
+                return false;
+            }
+            wakeWorker();
+            this_thread::yield();
+        }
+        accepted++;
+        wakeWorker();
+        return true;
+    }
+
+    // Wait until everything accepted so far has been delivered
+    void flush() {
+        while (delivered.load() < accepted.load()) {
+            wakeWorker();
+            this_thread::yield();
+        }
+    }
+
+    uint64_t droppedCount() const {
+        return dropped.load();
+    }
 };
 
 // Strategy Pattern - Split strategies
 class SplitStrategy {
 public:
-    virtual vector<Split> calculateSplit(double totalAmount, const vector<string>& userIds, 
-                                       const vector<double>& values = {}) = 0;
+    // Writes one split per user into `out`, which is cleared first and keeps its
+    // capacity, so a reused buffer makes splitting allocation-free.
+    // values: exact amounts in rupees for EXACT, percentages for PERCENTAGE
+    virtual void calculateSplit(Money totalAmount, const vector<UserIndex>& users,
+                                const vector<double>& values, vector<Split>& out) = 0;
+
+    // Convenience form for string ids
+    vector<Split> calculateSplit(Money totalAmount, const vector<string>& userIds,
+                                 const vector<double>& values = {}) {
+        IdInterner& ids = IdInterner::users();
+        vector<UserIndex> users;
+        users.reserve(userIds.size());
+        for (const string& userId : userIds) {
+            users.push_back(ids.intern(userId));
+        }
+        vector<Split> splits;
+        calculateSplit(totalAmount, users, values, splits);
+        return splits;
+    }
 };
 
 class EqualSplit : public SplitStrategy {
 public:
-    vector<Split> calculateSplit(double totalAmount, const vector<string>& userIds, 
-                               const vector<double>& values = {}) override {
-        vector<Split> splits;
-        double amountPerUser = totalAmount / userIds.size();
+    using SplitStrategy::calculateSplit;
+
+    void calculateSplit(Money totalAmount, const vector<UserIndex>& users,
+                        const vector<double>& values, vector<Split>& out) override {
+        out.clear();
+        if (users.empty()) {
+            throw runtime_error("an equal split needs at least one user");
+        }
+        int64_t count = users.size();
+        int64_t amountPerUser = totalAmount.paise / count;
+        int64_t remainder = totalAmount.paise - amountPerUser * count;
+        int64_t step = (remainder < 0) ? -1 : 1;
         
-        for (const string& userId : userIds) {
-            splits.push_back(Split(userId, amountPerUser));
+        // Leftover paise go one each to the first users, so the splits always sum to the total
+        for (int64_t i = 0; i < count; i++) {
+            int64_t extra = (i < remainder * step) ? step : 0;
+            out.push_back(Split(users[i], Money(amountPerUser + extra)));
         }
-        return splits;
     }
 };
 
 class ExactSplit : public SplitStrategy {
 public:
-    vector<Split> calculateSplit(double totalAmount, const vector<string>& userIds, 
-                               const vector<double>& values = {}) override {
-        vector<Split> splits;
+    using SplitStrategy::calculateSplit;
+
+    void calculateSplit(Money totalAmount, const vector<UserIndex>& users,
+                        const vector<double>& values, vector<Split>& out) override {
+        out.clear();
 
         //validations
         
-        for (int i = 0; i < userIds.size(); i++) {
-            splits.push_back(Split(userIds[i], values[i]));
+        for (int i = 0; i < users.size(); i++) {
+            out.push_back(Split(users[i], Money::fromRupees(values[i])));
         }
-        return splits;
     }
 };
 
 class PercentageSplit : public SplitStrategy {
 public:
-    vector<Split> calculateSplit(double totalAmount, const vector<string>& userIds, 
-                               const vector<double>& values = {}) override {
-        vector<Split> splits;
+    using SplitStrategy::calculateSplit;
+
+    void calculateSplit(Money totalAmount, const vector<UserIndex>& users,
+                        const vector<double>& values, vector<Split>& out) override {
+        out.clear();
 
         //validations
         
-        for (int i = 0; i < userIds.size(); i++) {
-            double amount = (totalAmount * values[i]) / 100.0;
-            splits.push_back(Split(userIds[i], amount));
+        // Round every share down, then hand the leftover paise to the largest
+        // fractional remainders (ties by position) so the shares sum to the total.
+        // The strategy is shared between threads, so the scratch buffer is per thread.
+        static thread_local vector<pair<double, int>> remainders;
+        remainders.clear();
+        int64_t allocated = 0;
+        for (int i = 0; i < users.size(); i++) {
+            double exact = (totalAmount.paise * values[i]) / 100.0;
+            int64_t amount = (int64_t)floor(exact);
+            out.push_back(Split(users[i], Money(amount)));
+            remainders.push_back({exact - amount, i});
+            allocated += amount;
+        }
+        stable_sort(remainders.begin(), remainders.end(),
+                    [](const pair<double, int>& a, const pair<double, int>& b) {
+                        return a.first > b.first;
+                    });
+        int64_t leftover = totalAmount.paise - allocated;
+        for (size_t i = 0; i < remainders.size() && leftover > 0; i++, leftover--) {
+            out[remainders[i].second].amount += Money(1);
         }
-        return splits;
     }
 };
 
 // Factory for split strategies
+// Strategies are stateless, so one shared instance of each is handed out
 class SplitFactory {
 public:
     static SplitStrategy* getSplitStrategy(SplitType type) {
+        static EqualSplit equalSplit;
+        static ExactSplit exactSplit;
+        static PercentageSplit percentageSplit;
+
         switch (type) {
             case SplitType::EQUAL:
-                return new EqualSplit();
+                return &equalSplit;
             case SplitType::EXACT:
-                return new ExactSplit();
+                return &exactSplit;
             case SplitType::PERCENTAGE:
-                return new PercentageSplit();
+                return &percentageSplit;
             default:
-                return new EqualSplit();
+                return &equalSplit;
         }
     }
 };
 
-// User class --> Concrete Observer
-class User : public Observer {
+// Everything Splitwise reports goes through an EventSink instead of straight to cout.
+// Events carry the pieces of a message (names, amounts) rather than formatted text,
+// so each sink only pays for the rendering it needs.
+enum class EventType : uint8_t {
+    USER_CREATED = 1,       // user = name, text = user id
+    GROUP_CREATED,          // group = name, text = group id
+    MEMBER_ADDED,           // user, group
+    MEMBER_LEFT,            // user, group
+    LEAVE_REFUSED,          // user, group; balances not cleared yet
+    NOTIFYING,              // group is about to notify its members of an expense
+    NOTIFICATION,           // user = recipient, text = message
+    GROUP_EXPENSE,          // group, user = payer, text = description, amount, names, values
+    EXPENSES_IMPORTED,      // group, count, amount = total
+    GROUP_SETTLEMENT,       // group, user paid other amount
+    DEBTS_SIMPLIFIED,       // group
+    INDIVIDUAL_EXPENSE,     // user = payer, other, text = description, amount
+    INDIVIDUAL_SETTLEMENT,  // user paid other amount
+    NOT_A_MEMBER,           // group
+    GROUP_NOT_FOUND,        // text = group id
+    USER_NOT_FOUND,         // text = user id
+    REPORT                  // text = rendered balance report (user or group set)
+};
+
+// Fields point into the caller's data and are only valid during record()
+struct Event {
+    EventType type;
+    const string* user = nullptr;
+    const string* other = nullptr;
+    const string* group = nullptr;
+    const string* text = nullptr;
+    Money amount;
+    uint64_t count = 0;
+    const vector<const string*>* names = nullptr; // involved users
+    const vector<double>* values = nullptr;       // split values as entered
+
+    explicit Event(EventType type) : type(type) {}
+};
+
+// Sinks may be called from several threads at once (dispatcher, concurrent requests)
+class EventSink {
 public:
-    static int nextUserId;
-    string userId;
-    string name;
-    string email;
-    map<string, double> balances; // userId -> amount (positive = they owe you, negative = you owe them)
-    
-    User(const string& name, const string& email) {
-        this->userId = "user" + to_string(++nextUserId);
-        this->name = name;
-        this->email = email;
-    }
-    
-    void update(const string& message) override {
-        cout << "[NOTIFICATION to " << name << "]: " << message << endl;
-    }
-    
-    void updateBalance(const string& otherUserId, double amount) {
-        balances[otherUserId] += amount;
-        
-        // Remove if balance becomes zero
-        if (abs(balances[otherUserId]) < 0.01) {
-            balances.erase(otherUserId);
-        }
-    }
-    
-    double getTotalOwed() {
-        double total = 0;
-        for (const auto& balance : balances) {
-            if (balance.second < 0) {
-                total += abs(balance.second);
-            }
-        }
-        return total;
-    }
-    
-    double getTotalOwing() {
-        double total = 0;
-        for (const auto& balance : balances) {
-            if (balance.second > 0) {
-                total += balance.second;
-            }
-        }
-        return total;
+    virtual ~EventSink() {}
+
+    virtual void record(const Event& event) = 0;
+
+    // False when events are dropped, so callers can skip building them
+    virtual bool enabled() const {
+        return true;
     }
+
+    // Push anything buffered to its destination
+    virtual void flush() {}
+
+    // Where Splitwise, its groups and its users report to: console text unless replaced.
+    // A replaced sink must outlive every thread still using the instance.
+    static EventSink& current();
+    // nullptr = back to the console; returns the sink installed before
+    static EventSink* install(EventSink* sink);
+
+private:
+    static atomic<EventSink*> installed;
 };
-int User::nextUserId = 0;
 
-// Expense Model class
-class Expense {
+// Drops everything; events are not even built
+class NullSink : public EventSink {
 public:
-    static int nextExpenseId;
-    string expenseId;
-    string description;
-    double totalAmount;
-    string paidByUserId;
-    vector<Split> splits;
-    string groupId;
-    
-    Expense(const string& desc, double amount, const string& paidBy,
-            vector<Split>& splits, const string group="") {
-        this->expenseId = "expense" + std::to_string(++nextExpenseId);
-        this->description = desc;
-        this->totalAmount = amount;
-        this->paidByUserId = paidBy;
-        this->splits = splits;
-        this->groupId = group;
+    void record(const Event&) override {}
+
+    bool enabled() const override {
+        return false;
     }
 };
-int Expense::nextExpenseId = 0;
 
-class DebtSimplifier {
-public:
-    static map<string, map<string, double>> simplifyDebts(
-        map<string, map<string, double>> groupBalances) {
-        
-        // Calculate net amount for each person
-        map<string, double> netAmounts;
-        
-        // Initialize all users with 0
-        for (const auto& userBalance : groupBalances) {
-            netAmounts[userBalance.first] = 0;
-        }
-        
-        // Calculate net amounts
-        // We only need to process each balance once (not twice)
-        // If groupBalances[A][B] = 200, it means B owes A 200
-        // So A should receive 200 (positive) and B should pay 200 (negative)
-        for (const auto& userBalance : groupBalances) {
+// Human readable text, one line per message. Lines are written with "\n" rather than
+// endl and handed to the stream once `flushBytes` have accumulated (0 = after every
+// event, which keeps the order with other writes to the same stream).
+class BufferedTextSink : public EventSink {
+private:
+    ostream& out;
+    size_t flushBytes;
+    string pending;
+    ostringstream line; // for split values, formatted like cout's defaults
+    mutex sinkMutex;
+
+    void render(const Event& event) {
+        switch (event.type) {
+            case EventType::USER_CREATED:
+                pending += "User created: " + *event.user + " (ID: " + *event.text + ")\n";
+                break;
+            case EventType::GROUP_CREATED:
+                pending += "Group created: " + *event.group + " (ID: " + *event.text + ")\n";
+                break;
+            case EventType::MEMBER_ADDED:
+                pending += *event.user + " added to group " + *event.group + "\n";
+                break;
+            case EventType::MEMBER_LEFT:
+                pending += *event.user + " successfully left " + *event.group + "\n";
+                break;
+            case EventType::LEAVE_REFUSED:
+                pending += "\nUser not allowed to leave group without clearing expenses\n";
+                break;
+            case EventType::NOTIFYING:
+                pending += "\n=========== Sending Notifications ====================\n";
+                break;
+            case EventType::NOTIFICATION:
+                pending += "[NOTIFICATION to " + *event.user + "]: " + *event.text + "\n";
+                break;
+            case EventType::GROUP_EXPENSE:
+                pending += "\n=========== Expense Message ====================\n";
+                pending += "Expense added to " + *event.group + ": " + *event.text + " (Rs " + event.amount.toString()
+                         + ") paid by " + *event.user + " and involved people are : \n";
+                if (!event.values->empty()) {
+                    for (size_t i = 0; i < event.values->size(); i++) {
+                        line.str("");
+                        line << (*event.values)[i];
+                        pending += *(*event.names)[i] + " : " + line.str() + "\n";
+                    }
+                } else {
+                    for (const string* name : *event.names) {
+                        pending += *name + ", ";
+                    }
+                    pending += "\nWill be Paid Equally\n";
+                }
+                break;
+            case EventType::EXPENSES_IMPORTED:
+                pending += "Imported " + to_string(event.count) + " expenses into " + *event.group
+                         + " (Rs " + event.amount.toString() + ")\n";
+                break;
+            case EventType::GROUP_SETTLEMENT:
+                pending += "Settlement in " + *event.group + ": " + *event.user + " settled Rs "
+                         + event.amount.toString() + " with " + *event.other + "\n";
+                break;
+            case EventType::DEBTS_SIMPLIFIED:
+                pending += "\nDebts have been simplified for group: " + *event.group + "\n";
+                break;
+            case EventType::INDIVIDUAL_EXPENSE:
+                pending += "Individual expense added: " + *event.text + " (Rs " + event.amount.toString()
+                         + ") paid by " + *event.user + " for " + *event.other + "\n";
+                break;
+            case EventType::INDIVIDUAL_SETTLEMENT:
+                pending += *event.user + " settled Rs" + event.amount.toString() + " with " + *event.other + "\n";
+                break;
+            case EventType::NOT_A_MEMBER:
+                pending += "user is not a part of this group\n";
+                break;
+            case EventType::GROUP_NOT_FOUND:
+                pending += "Group not found!\n";
+                break;
+            case EventType::USER_NOT_FOUND:
+                pending += "User not found!\n";
+                break;
+            case EventType::REPORT:
+                pending += *event.text;
+                break;
+        }
+    }
+
+    void writePending() {
+        out.write(pending.data(), pending.size());
+        pending.clear();
+    }
+
+public:
+    BufferedTextSink(ostream& out, size_t flushBytes = 0) : out(out), flushBytes(flushBytes) {}
+
+    ~BufferedTextSink() {
+        flush();
+    }
+
+    void record(const Event& event) override {
+        if (!enabled()) return;
+        lock_guard<mutex> lock(sinkMutex);
+        render(event);
+        if (pending.size() >= flushBytes) {
+            writePending();
+        }
+    }
+
+    // A stream with its buffer detached (cout.rdbuf(nullptr)) would drop the text anyway
+    bool enabled() const override {
+        return out.rdbuf() != nullptr;
+    }
+
+    void flush() override {
+        lock_guard<mutex> lock(sinkMutex);
+        writePending();
+        out.flush();
+    }
+};
+
+// Compact audit stream appended to a file. Each event is
+//   u8 type, u8 field mask, then the present fields in declaration order:
+//   strings as varint length + bytes, amount as zigzag varint paise, count as varint,
+//   names as varint count + strings, values as varint count + 8 byte doubles.
+// Events are buffered and written with write() once `flushBytes` have accumulated.
+class BinaryEventSink : public EventSink {
+private:
+    int fd;
+    size_t flushBytes;
+    string pending;
+    uint64_t events = 0;
+    mutex sinkMutex;
+
+    enum Field : uint8_t {
+        USER = 1, OTHER = 2, GROUP = 4, TEXT = 8, AMOUNT = 16, COUNT = 32, NAMES = 64, VALUES = 128
+    };
+
+    void varint(uint64_t value) {
+        while (value >= 0x80) {
+            pending += (char)(value | 0x80);
+            value >>= 7;
+        }
+        pending += (char)value;
+    }
+
+    void str(const string& value) {
+        varint(value.size());
+        pending += value;
+    }
+
+    void writePending() {
+        size_t done = 0;
+        while (done < pending.size()) {
+            ssize_t written = ::write(fd, pending.data() + done, pending.size() - done);
+            if (written < 0) throw runtime_error("cannot write event stream");
+            done += written;
+        }
+        pending.clear();
+    }
+
+public:
+    BinaryEventSink(const string& path, size_t flushBytes = 64 * 1024) : flushBytes(flushBytes) {
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd < 0) throw runtime_error("cannot open event stream " + path);
+    }
+
+    ~BinaryEventSink() {
+        flush();
+        close(fd);
+    }
+
+    void record(const Event& event) override {
+        uint8_t mask = (event.user ? USER : 0) | (event.other ? OTHER : 0) | (event.group ? GROUP : 0)
+                     | (event.text ? TEXT : 0) | (event.amount.isZero() ? 0 : AMOUNT)
+                     | (event.count ? COUNT : 0) | (event.names ? NAMES : 0) | (event.values ? VALUES : 0);
+
+        lock_guard<mutex> lock(sinkMutex);
+        pending += (char)event.type;
+        pending += (char)mask;
+        if (event.user) str(*event.user);
+        if (event.other) str(*event.other);
+        if (event.group) str(*event.group);
+        if (event.text) str(*event.text);
+        if (mask & AMOUNT) varint(((uint64_t)event.amount.paise << 1) ^ (uint64_t)(event.amount.paise >> 63));
+        if (event.count) varint(event.count);
+        if (event.names) {
+            varint(event.names->size());
+            for (const string* name : *event.names) str(*name);
+        }
+        if (event.values) {
+            varint(event.values->size());
+            pending.append((const char*)event.values->data(), event.values->size() * sizeof(double));
+        }
+        events++;
+        if (pending.size() >= flushBytes) {
+            writePending();
+        }
+    }
+
+    void flush() override {
+        lock_guard<mutex> lock(sinkMutex);
+        writePending();
+    }
+
+    uint64_t eventCount() {
+        lock_guard<mutex> lock(sinkMutex);
+        return events;
+    }
+};
+
+atomic<EventSink*> EventSink::installed(nullptr);
+
+EventSink& EventSink::current() {
+    static BufferedTextSink console(cout);
+    EventSink* sink = installed.load(memory_order_acquire);
+    return sink ? *sink : console;
+}
+
+EventSink* EventSink::install(EventSink* sink) {
+    return installed.exchange(sink, memory_order_acq_rel);
+}
+
+// User class --> Concrete Observer
+class User : public Observer {
+public:
+    static atomic<int> nextUserId;
+    string userId;
+    UserIndex index;
+    string name;
+    string email;
+    FlatIndexMap<Money> balances; // user index -> amount (positive = they owe you, negative = you owe them)
+    mutex balanceMutex;           // guards balances, see UserPairLock
+    
+    User(const string& name, const string& email) {
+        this->userId = "user" + to_string(++nextUserId);
+        this->index = IdInterner::users().intern(userId);
+        this->name = name;
+        this->email = email;
+    }
+    
+    void update(const string& message) override {
+        Event event(EventType::NOTIFICATION);
+        event.user = &name;
+        event.text = &message;
+        EventSink::current().record(event);
+    }
+
+    void updateBatch(const vector<const string*>& messages) override {
+        EventSink& sink = EventSink::current();
+        Event event(EventType::NOTIFICATION);
+        event.user = &name;
+        for (const string* message : messages) {
+            event.text = message;
+            sink.record(event);
+        }
+    }
+    
+    void updateBalance(const string& otherUserId, Money amount) {
+        updateBalance(IdInterner::users().intern(otherUserId), amount);
+    }
+
+    void updateBalance(UserIndex other, Money amount) {
+        Money& balance = balances[other];
+        balance += amount;
+        
+        // Remove if balance becomes zero
+        if (balance.isZero()) {
+            balances.erase(other);
+        }
+    }
+    
+    // Both totals scan the flat row; empty slots hold zero and add nothing
+    Money getTotalOwed() {
+        return Money(sumNegative(balances.rawValues(), balances.capacity()));
+    }
+    
+    Money getTotalOwing() {
+        return Money(sumPositive(balances.rawValues(), balances.capacity()));
+    }
+};
+atomic<int> User::nextUserId(0);
+
+// Expense Model class
+class Expense {
+public:
+    static atomic<int> nextExpenseId;
+    string expenseId;
+    string description;
+    Money totalAmount;
+    string paidByUserId;
+    vector<Split> splits;
+    string groupId;
+    int64_t timestamp; // seconds since the epoch
+    
+    // Takes ownership of the splits; pass them with move()
+    Expense(const string& desc, Money amount, const string& paidBy,
+            vector<Split> splits, const string group="") {
+        this->expenseId = "expense" + std::to_string(++nextExpenseId);
+        this->description = desc;
+        this->totalAmount = amount;
+        this->paidByUserId = paidBy;
+        this->splits = move(splits);
+        this->groupId = group;
+        this->timestamp = time(nullptr);
+    }
+
+    // Rebuilt from the ledger: keeps the id and time it was booked with
+    Expense(const string& expenseId, int64_t timestamp, const string& desc, Money amount,
+            const string& paidBy, vector<Split> splits, const string group="") {
+        this->expenseId = expenseId;
+        this->description = desc;
+        this->totalAmount = amount;
+        this->paidByUserId = paidBy;
+        this->splits = move(splits);
+        this->groupId = group;
+        this->timestamp = timestamp;
+    }
+};
+atomic<int> Expense::nextExpenseId(0);
+
+// One payment of a settlement plan: from pays to
+struct Transfer {
+    UserIndex from;
+    UserIndex to;
+    Money amount;
+};
+
+enum class SimplifyMode {
+    GREEDY, // largest creditor vs largest debtor via heaps, O(n log n)
+    EXACT,  // minimum number of transfers, exponential - small groups only
+    AUTO    // EXACT up to DebtSimplifier::AUTO_EXACT_CUTOFF non-zero members, GREEDY beyond
+};
+
+class DebtSimplifier {
+private:
+    // Heap-based greedy over the given positions of users/nets
+    static void greedyTransfers(const vector<UserIndex>& users, const vector<int64_t>& nets,
+                                const vector<size_t>& positions, vector<Transfer>& out) {
+        priority_queue<pair<int64_t, size_t>> creditors; // (amount to receive, position)
+        priority_queue<pair<int64_t, size_t>> debtors;   // (amount to pay, position)
+        for (size_t position : positions) {
+            if (nets[position] > 0) creditors.push({nets[position], position});
+            if (nets[position] < 0) debtors.push({-nets[position], position});
+        }
+        while (!creditors.empty() && !debtors.empty()) {
+            pair<int64_t, size_t> creditor = creditors.top();
+            pair<int64_t, size_t> debtor = debtors.top();
+            creditors.pop();
+            debtors.pop();
+
+            int64_t settleAmount = min(creditor.first, debtor.first);
+            out.push_back({users[debtor.second], users[creditor.second], Money(settleAmount)});
+
+            if (creditor.first > settleAmount) creditors.push({creditor.first - settleAmount, creditor.second});
+            if (debtor.first > settleAmount) debtors.push({debtor.first - settleAmount, debtor.second});
+        }
+    }
+
+    // Minimum transfers = (non-zero members) - (max number of disjoint zero-sum subsets).
+    // best[mask] is the max number of zero-sum subsets the members in mask can be split into.
+    static void exactTransfers(const vector<UserIndex>& users, const vector<int64_t>& nets,
+                               const vector<size_t>& positions, vector<Transfer>& out) {
+        size_t count = positions.size();
+        size_t full = (size_t(1) << count) - 1;
+        vector<int64_t> sum(full + 1, 0);
+        vector<uint8_t> best(full + 1, 0);
+        for (size_t mask = 1; mask <= full; mask++) {
+            sum[mask] = sum[mask & (mask - 1)] + nets[positions[__builtin_ctzll(mask)]];
+            uint8_t most = 0;
+            for (size_t rest = mask; rest; rest &= rest - 1) {
+                most = max(most, best[mask ^ (rest & -rest)]);
+            }
+            best[mask] = most + (sum[mask] == 0 ? 1 : 0);
+        }
+
+        // Peel members off one at a time along an optimal path; every time the remaining
+        // set sums to zero, the members peeled since the last such point form one subset
+        vector<size_t> subset;
+        for (size_t mask = full; mask; ) {
+            uint8_t target = best[mask] - (sum[mask] == 0 ? 1 : 0);
+            for (size_t rest = mask; rest; rest &= rest - 1) {
+                size_t bit = rest & -rest;
+                if (best[mask ^ bit] == target) {
+                    subset.push_back(positions[__builtin_ctzll(bit)]);
+                    mask ^= bit;
+                    break;
+                }
+            }
+            if (sum[mask] == 0) {
+                greedyTransfers(users, nets, subset, out); // size - 1 transfers for a zero-sum subset
+                subset.clear();
+            }
+        }
+    }
+
+public:
+    static const size_t EXACT_CUTOFF = 20;
+    // AUTO runs on the write path with the group lock held, so it only goes exact while
+    // the 2^n subset DP stays well under a millisecond (about 0.15 ms at 14)
+    static const size_t AUTO_EXACT_CUTOFF = 14;
+
+    // EXACT or GREEDY: what `mode` means for this many non-zero members
+    static SimplifyMode resolve(SimplifyMode mode, size_t openPositions) {
+        if (mode != SimplifyMode::AUTO) return mode;
+        return openPositions <= AUTO_EXACT_CUTOFF ? SimplifyMode::EXACT : SimplifyMode::GREEDY;
+    }
+
+    // Settlement plan from net positions (positive = should receive). nets must sum to zero.
+    static vector<Transfer> planTransfers(const vector<UserIndex>& users, const vector<Money>& nets,
+                                          SimplifyMode mode = SimplifyMode::AUTO) {
+        vector<int64_t> amounts(nets.size());
+        vector<size_t> positions;
+        for (size_t i = 0; i < nets.size(); i++) {
+            amounts[i] = nets[i].paise;
+            if (amounts[i] != 0) positions.push_back(i);
+        }
+
+        bool exact = resolve(mode, positions.size()) == SimplifyMode::EXACT;
+        if (exact && positions.size() > EXACT_CUTOFF) {
+            throw runtime_error("exact debt simplification is limited to " + to_string(EXACT_CUTOFF) + " members");
+        }
+
+        vector<Transfer> transfers;
+        if (exact) {
+            exactTransfers(users, amounts, positions, transfers);
+        } else {
+            greedyTransfers(users, amounts, positions, transfers);
+        }
+        return transfers;
+    }
+
+    // Original map-based greedy simplifier
+    static map<string, map<string, Money>> simplifyDebts(
+        map<string, map<string, Money>> groupBalances) {
+        
+        // Calculate net amount for each person
+        map<string, Money> netAmounts;
+        
+        // Initialize all users with 0
+        for (const auto& userBalance : groupBalances) {
+            netAmounts[userBalance.first] = Money();
+        }
+        
+        // Calculate net amounts
+        // We only need to process each balance once (not twice)
+        // If groupBalances[A][B] = 200, it means B owes A 200
+        // So A should receive 200 (positive) and B should pay 200 (negative)
+        for (const auto& userBalance : groupBalances) {
             string creditorId = userBalance.first;
             for (const auto& balance : userBalance.second) {
                 string debtorId = balance.first;
-                double amount = balance.second;
+                Money amount = balance.second;
                 
                 // Only process positive amounts to avoid double counting
-                if (amount > 0) {
+                if (amount.paise > 0) {
                     netAmounts[creditorId] += amount;  // creditor receives
                     netAmounts[debtorId] -= amount;    // debtor pays
                 }
@@ -209,33 +1210,33 @@ public:
         }
         
         // Divide users into creditors and debtors
-        vector<pair<string, double>> creditors; // those who should receive money
-        vector<pair<string, double>> debtors;   // those who should pay money
+        vector<pair<string, Money>> creditors; // those who should receive money
+        vector<pair<string, Money>> debtors;   // those who should pay money
         
         for (const auto& net : netAmounts) {
-            if (net.second > 0.01) { // creditor
+            if (net.second.paise > 0) { // creditor
                 creditors.push_back({net.first, net.second});
-            } else if (net.second < -0.01) { // debtor
+            } else if (net.second.paise < 0) { // debtor
                 debtors.push_back({net.first, -net.second}); // store positive amount
             }
         }
         
         // Sort for better optimization (largest amounts first)
         sort(creditors.begin(), creditors.end(), 
-             [](const pair<string, double>& a, const pair<string, double>& b) {
+             [](const pair<string, Money>& a, const pair<string, Money>& b) {
                  return a.second > b.second;
              });
         sort(debtors.begin(), debtors.end(), 
-             [](const pair<string, double>& a, const pair<string, double>& b) {
+             [](const pair<string, Money>& a, const pair<string, Money>& b) {
                  return a.second > b.second;
              });
         
         // Create new simplified balance map
-        map<string, map<string, double>> simplifiedBalances;
+        map<string, map<string, Money>> simplifiedBalances;
         
         // Initialize empty maps for all users
         for (const auto& userBalance : groupBalances) {
-            simplifiedBalances[userBalance.first] = map<string, double>();
+            simplifiedBalances[userBalance.first] = map<string, Money>();
         }
         
         // Use greedy algorithm to minimize transactions
@@ -243,11 +1244,11 @@ public:
         while (i < creditors.size() && j < debtors.size()) {
             string creditorId = creditors[i].first;
             string debtorId = debtors[j].first;
-            double creditorAmount = creditors[i].second;
-            double debtorAmount = debtors[j].second;
+            Money creditorAmount = creditors[i].second;
+            Money debtorAmount = debtors[j].second;
             
             // Find the minimum amount to settle
-            double settleAmount = min(creditorAmount, debtorAmount);
+            Money settleAmount = min(creditorAmount, debtorAmount);
             
             // Update simplified balances
             // debtorId owes creditorId the settleAmount
@@ -259,10 +1260,10 @@ public:
             debtors[j].second -= settleAmount;
             
             // Move to next creditor or debtor if current one is settled
-            if (creditors[i].second < 0.01) {
+            if (creditors[i].second.isZero()) {
                 i++;
             }
-            if (debtors[j].second < 0.01) {
+            if (debtors[j].second.isZero()) {
                 j++;
             }
         }
@@ -271,416 +1272,3443 @@ public:
     }
 };
 
-// Group class --> Concrete Observable
-class Group {
+// Settlement plan across every group and individual balance at once. Each user gets one
+// net position over all their balances; users linked by any balance form a connected
+// component of the debt graph whose nets sum to zero, so components are planned
+// independently (and in parallel) with DebtSimplifier::planTransfers. Small components
+// get the exact minimum under AUTO even when the whole graph is large.
+class GlobalSettlementPlanner {
 private:
-    User* getUserByuserId(string userId) {
-        User* user = nullptr;
+    vector<Money> nets;       // user index -> net position (positive = should receive)
+    vector<uint32_t> parent;  // union-find over user indices
+    vector<uint8_t> rank;
 
-        for(User *member : members) {
-            if(member->userId == userId) {
-                user = member;
-            }
+    uint32_t root(uint32_t user) {
+        while (parent[user] != user) {
+            parent[user] = parent[parent[user]]; // path halving
+            user = parent[user];
         }
         return user;
     }
-    
-public:
-    static int nextGroupId;
-    string groupId;
-    string name;
-    vector<User*> members; //observers
-    map<string, Expense*> groupExpenses; // Group's own expense book
-    map<string, map<string, double>> groupBalances; // memberId -> {otherMemberId -> balance}
-    
-    Group(const string& name) {
-        this->groupId = "group" + std::to_string(++nextGroupId);
-        this->name = name;
+
+    // Users created while the planner is being fed get indices past the initial size
+    void reserveUser(uint32_t user) {
+        while (user >= nets.size()) {
+            parent.push_back(nets.size());
+            nets.push_back(Money());
+            rank.push_back(0);
+        }
     }
-    
-    ~Group() {
-        // Clean up group's expenses
-        for (auto& pair : groupExpenses) {
-            delete pair.second;
+
+    void join(uint32_t a, uint32_t b) {
+        a = root(a);
+        b = root(b);
+        if (a == b) return;
+        if (rank[a] < rank[b]) swap(a, b);
+        parent[b] = a;
+        if (rank[a] == rank[b]) rank[a]++;
+    }
+
+public:
+    explicit GlobalSettlementPlanner(size_t userCount) : nets(userCount), parent(userCount), rank(userCount) {
+        for (uint32_t i = 0; i < userCount; i++) {
+            parent[i] = i;
         }
     }
-    
-    void addMember(User* user) {
-        members.push_back(user);
 
-        // Initialize balance map for new member
-        groupBalances[user->userId] = map<string, double>();
-        cout << user->name << " added to group " << name << endl;
+    // One side of a balance: `user`'s entry for `other` (positive = other owes user).
+    // Balances are stored on both sides, so each side is added by its own user.
+    void addBalance(UserIndex user, UserIndex other, Money amount) {
+        reserveUser(max(user, other));
+        nets[user] += amount;
+        join(user, other);
     }
-    
-    bool removeMember(const string& userId) {    
-        // Check if user can be removed or not
-        if(!canUserLeaveGroup(userId)) {
-            cout <<"\nUser not allowed to leave group without clearing expenses" << endl;
-            return false;
+
+    // threads = 0 uses every hardware thread
+    vector<Transfer> plan(SimplifyMode mode = SimplifyMode::AUTO, unsigned threads = 0) {
+        // Open positions grouped by component
+        vector<uint32_t> componentOf(nets.size(), UINT32_MAX);
+        vector<vector<UserIndex>> componentUsers;
+        vector<vector<Money>> componentNets;
+        for (uint32_t user = 0; user < nets.size(); user++) {
+            if (nets[user].isZero()) continue;
+            uint32_t& component = componentOf[root(user)];
+            if (component == UINT32_MAX) {
+                component = componentUsers.size();
+                componentUsers.emplace_back();
+                componentNets.emplace_back();
+            }
+            componentUsers[component].push_back(user);
+            componentNets[component].push_back(nets[user]);
         }
-        
-        // Remove from observers
-        for (User *user : members) {
-            if (user->userId == userId) {
-                members.erase(remove(members.begin(), members.end(), user),members.end());
-                break;
+
+        // Workers pull components off a shared counter; plans are joined in component order
+        vector<vector<Transfer>> plans(componentUsers.size());
+        atomic<size_t> next{0};
+        auto worker = [&]() {
+            for (size_t c = next++; c < plans.size(); c = next++) {
+                plans[c] = DebtSimplifier::planTransfers(componentUsers[c], componentNets[c], mode);
             }
+        };
+        if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+        threads = min<size_t>(threads, max<size_t>(1, plans.size()));
+        vector<thread> pool;
+        for (unsigned t = 1; t < threads; t++) {
+            pool.emplace_back(worker);
         }
-        
-        // Remove from group balances
-        groupBalances.erase(userId);
-        
-        // Remove this user from other members' balance maps
-        for (auto& memberBalance : groupBalances) {
-            memberBalance.second.erase(userId);
+        worker();
+        for (thread& t : pool) {
+            t.join();
         }
-        return true;
+
+        vector<Transfer> transfers;
+        for (const vector<Transfer>& componentPlan : plans) {
+            transfers.insert(transfers.end(), componentPlan.begin(), componentPlan.end());
+        }
+        return transfers;
     }
-    
-    void notifyMembers(const string& message) {
-        for (Observer* observer : members) {
-            observer->update(message);
+};
+
+// Flat group balance table keyed by interned user index.
+// Each member owns a row: otherMember -> balance (positive = they owe this member).
+// The user index -> slot mapping doubles as the group's membership index: Group keeps
+// its observer list aligned with these slots and mirrors every swap-and-pop.
+class BalanceTable {
+private:
+    FlatIndexMap<uint32_t> rowOf;            // user index -> row
+    vector<UserIndex> owners;                // row -> user index
+    vector<FlatIndexMap<Money>> rows;
+    vector<Money> nets;                      // row -> net position, maintained by add()
+    vector<uint8_t> touched;                 // row -> already in dirty?
+    vector<UserIndex> dirty;                 // members whose net changed since takeDirty()
+
+    void markDirty(uint32_t row) {
+        if (!touched[row]) {
+            touched[row] = 1;
+            dirty.push_back(owners[row]);
         }
     }
 
-    bool isMember(const string& userId) {
-        return groupBalances.find(userId) != groupBalances.end();
+public:
+    bool contains(UserIndex user) const {
+        return rowOf.find(user) != nullptr;
     }
-    
-    // Update balance within group
-    void updateGroupBalance(const string& fromUserId, const string& toUserId, double amount) {
-        groupBalances[fromUserId][toUserId] += amount;
-        groupBalances[toUserId][fromUserId] -= amount;
-        
-        // Remove if balance becomes zero
-        if (abs(groupBalances[fromUserId][toUserId]) < 0.01) {
-            groupBalances[fromUserId].erase(toUserId);
-        }
-        if (abs(groupBalances[toUserId][fromUserId]) < 0.01) {
-            groupBalances[toUserId].erase(fromUserId);
-        }
+
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+    uint32_t slotOf(UserIndex user) const {
+        const uint32_t* slot = rowOf.find(user);
+        return slot ? *slot : NO_SLOT;
     }
-    
-    // Check if user can leave group.
-    bool canUserLeaveGroup(const string& userId) {
-        if (!isMember(userId)) {
-            throw runtime_error("user is not a part of this group");
-        };
-        
-        // Check if user has any outstanding balance with other group members
-        map<string, double> userBalanceSheet = groupBalances[userId];
-        for (auto& balance : userBalanceSheet) {
-            if (abs(balance.second) > 0.01) {
-                return false; // Has outstanding balance
-            }
+
+    // Returns the member's slot (rows are appended)
+    uint32_t addRow(UserIndex user) {
+        if (contains(user)) return *rowOf.find(user);
+        rowOf[user] = rows.size();
+        owners.push_back(user);
+        rows.push_back(FlatIndexMap<Money>());
+        nets.push_back(Money());
+        touched.push_back(0);
+        return rows.size() - 1;
+    }
+
+    // Swap-and-pop the member's row and drop it from every counterparty's row.
+    // Returns the vacated slot (now holding what was the last slot), or NO_SLOT.
+    uint32_t removeRow(UserIndex user) {
+        uint32_t* slot = rowOf.find(user);
+        if (!slot) return NO_SLOT;
+        uint32_t row = *slot;
+
+        rows[row].forEach([&](uint32_t other, Money) {
+            FlatIndexMap<Money>* otherRow = find(other);
+            if (otherRow) otherRow->erase(user);
+        });
+
+        uint32_t last = rows.size() - 1;
+        if (row != last) {
+            rows[row] = move(rows[last]);
+            owners[row] = owners[last];
+            nets[row] = nets[last];
+            touched[row] = touched[last];
+            rowOf[owners[row]] = row;
         }
-        return true;
+        rows.pop_back();
+        owners.pop_back();
+        nets.pop_back();
+        touched.pop_back();
+        rowOf.erase(user);
+        return row;
     }
-    
-    // Get user's balance within this group
-    map<string, double> getUserGroupBalances(const string& userId) {
-        if (!isMember(userId)) {
-            throw runtime_error("user is not a part of this group");
-        };
-        return groupBalances[userId];
+
+    FlatIndexMap<Money>* find(UserIndex user) {
+        uint32_t* slot = rowOf.find(user);
+        return slot ? &rows[*slot] : nullptr;
     }
-    
-    // Add expense to this group
-    bool addExpense(string& description, double amount, string& paidByUserId,
-                   vector<string>& involvedUsers, SplitType splitType, 
-                   const vector<double>& splitValues = {}) {
-        
-        if (!isMember(paidByUserId)) {
-            throw runtime_error("user is not a part of this group");
+
+    const FlatIndexMap<Money>* find(UserIndex user) const {
+        const uint32_t* slot = rowOf.find(user);
+        return slot ? &rows[*slot] : nullptr;
+    }
+
+    // from is owed `amount` more by to (and to owes from the same)
+    void add(UserIndex from, UserIndex to, Money amount) {
+        uint32_t fromSlot = *rowOf.find(from);
+        uint32_t toSlot = *rowOf.find(to);
+        FlatIndexMap<Money>& fromRow = rows[fromSlot];
+        FlatIndexMap<Money>& toRow = rows[toSlot];
+
+        nets[fromSlot] += amount;
+        nets[toSlot] -= amount;
+        markDirty(fromSlot);
+        markDirty(toSlot);
+
+        Money& forward = fromRow[to];
+        forward += amount;
+        if (forward.isZero()) fromRow.erase(to);
+
+        Money& backward = toRow[from];
+        backward -= amount;
+        if (backward.isZero()) toRow.erase(from);
+    }
+
+    size_t memberCount() const {
+        return owners.size();
+    }
+
+    // Net position of a member: positive = the group owes them
+    Money net(UserIndex user) const {
+        return nets[*rowOf.find(user)];
+    }
+
+    bool hasDirty() const {
+        return !dirty.empty();
+    }
+
+    // Calls f(user, net) once for every member whose net changed since the last call
+    // (net is zero for members removed in between), then empties the dirty set
+    template <typename F>
+    void takeDirty(F f) {
+        for (UserIndex user : dirty) {
+            const uint32_t* slot = rowOf.find(user);
+            if (slot) {
+                touched[*slot] = 0;
+                f(user, nets[*slot]);
+            } else {
+                f(user, Money());
+            }
+        }
+        dirty.clear();
+    }
+
+    void discardDirty() {
+        for (UserIndex user : dirty) {
+            const uint32_t* slot = rowOf.find(user);
+            if (slot) touched[*slot] = 0;
+        }
+        dirty.clear();
+    }
+
+    void clearBalances() {
+        for (size_t row = 0; row < rows.size(); row++) {
+            rows[row] = FlatIndexMap<Money>();
+            nets[row] = Money();
+        }
+    }
+
+    // String-keyed view for code that still works on userId maps
+    map<string, map<string, Money>> toMap() const {
+        const IdInterner& ids = IdInterner::users();
+        map<string, map<string, Money>> result;
+        for (size_t row = 0; row < rows.size(); row++) {
+            map<string, Money>& out = result[ids.idOf(owners[row])];
+            rows[row].forEach([&](uint32_t other, Money amount) {
+                out[ids.idOf(other)] = amount;
+            });
+        }
+        return result;
+    }
+};
+
+// One row of a batch import (e.g. a line of an expense CSV)
+struct ExpenseRecord {
+    string description;
+    Money amount;
+    string paidByUserId;
+    vector<string> involvedUsers;
+    SplitType splitType;
+    vector<double> splitValues;
+};
+
+// Numeric part of a generated id: "user12" -> 12
+uint32_t idNumber(const string& id) {
+    size_t digits = id.find_first_of("0123456789");
+    return (digits == string::npos) ? 0 : stoul(id.substr(digits));
+}
+
+// Id number -> interned index for users read back from disk (12 -> "user12"), interning
+// each distinct user once instead of rebuilding the id string per reference
+class UserNumbers {
+private:
+    vector<UserIndex> indexOf;
+
+public:
+    UserIndex operator()(uint32_t number) {
+        if (number >= indexOf.size()) indexOf.resize(number + 1, IdInterner::NOT_FOUND);
+        if (indexOf[number] == IdInterner::NOT_FOUND) {
+            indexOf[number] = IdInterner::users().intern("user" + to_string(number));
+        }
+        return indexOf[number];
+    }
+};
+
+struct ByteWriter;
+struct ByteReader;
+
+// Columnar history of every booked split, one row per split, kept in parallel arrays
+// so statement queries stream through memory instead of chasing Expense pointers.
+// The scans are branchless (masks instead of ifs) so the compiler can vectorize them.
+// Appends take the lock exclusively, scans share it.
+class ExpenseColumns {
+public:
+    static const uint32_t NO_GROUP = 0; // group column of individual expenses
+
+private:
+    vector<int64_t> amounts;    // paise of the split
+    vector<UserIndex> payers;   // who paid the expense
+    vector<UserIndex> debtors;  // whose share the split is
+    vector<uint32_t> groups;    // group id number ("group3" -> 3)
+    vector<int64_t> timestamps; // seconds since the epoch
+    mutable shared_mutex mutex;
+
+    void appendLocked(UserIndex payer, UserIndex debtor, uint32_t group, int64_t timestamp, Money amount) {
+        amounts.push_back(amount.paise);
+        payers.push_back(payer);
+        debtors.push_back(debtor);
+        groups.push_back(group);
+        timestamps.push_back(timestamp);
+    }
+
+public:
+    void append(UserIndex payer, UserIndex debtor, uint32_t group, int64_t timestamp, Money amount) {
+        unique_lock<shared_mutex> lock(mutex);
+        appendLocked(payer, debtor, group, timestamp, amount);
+    }
+
+    void append(const Expense& expense) {
+        UserIndex payer = IdInterner::users().find(expense.paidByUserId);
+        uint32_t group = expense.groupId.empty() ? NO_GROUP : idNumber(expense.groupId);
+        unique_lock<shared_mutex> lock(mutex);
+        for (const Split& split : expense.splits) {
+            appendLocked(payer, split.user, group, expense.timestamp, split.amount);
+        }
+    }
+
+    size_t size() const {
+        shared_lock<shared_mutex> lock(mutex);
+        return amounts.size();
+    }
+
+    // Checkpoint form, see Splitwise::checkpoint()
+    void save(ByteWriter& out) const;
+    void load(ByteReader& in);
+
+    // What the user owes others and is owed by others over all recorded splits
+    // (shares of their own expenses excluded)
+    void totalsFor(UserIndex user, Money& owes, Money& owed) const {
+        shared_lock<shared_mutex> lock(mutex);
+        int64_t owesTotal = 0;
+        int64_t owedTotal = 0;
+        for (size_t i = 0; i < amounts.size(); i++) {
+            int64_t foreign = payers[i] != debtors[i];
+            owesTotal += amounts[i] & -(foreign & (debtors[i] == user));
+            owedTotal += amounts[i] & -(foreign & (payers[i] == user));
+        }
+        owes = Money(owesTotal);
+        owed = Money(owedTotal);
+    }
+
+    // totalsFor() of every user in one pass, indexed by UserIndex
+    void totalsForAll(vector<Money>& owes, vector<Money>& owed) const {
+        shared_lock<shared_mutex> lock(mutex);
+        owes.assign(IdInterner::users().size(), Money());
+        owed.assign(owes.size(), Money());
+        for (size_t i = 0; i < amounts.size(); i++) {
+            int64_t amount = amounts[i] & -(int64_t)(payers[i] != debtors[i]);
+            owes[debtors[i]].paise += amount;
+            owed[payers[i]].paise += amount;
+        }
+    }
+
+    // The user's own shares per period: bucket k covers [from + k * period, from + (k + 1) * period)
+    vector<Money> spendByPeriod(UserIndex user, int64_t from, int64_t period, size_t periodCount) const {
+        shared_lock<shared_mutex> lock(mutex);
+        // Rows of other users or outside the range land in a spare last bucket
+        vector<int64_t> buckets(periodCount + 1);
+        uint64_t span = period * periodCount;
+        for (size_t i = 0; i < amounts.size(); i++) {
+            uint64_t offset = timestamps[i] - from; // wraps for earlier rows, so one compare
+            bool hit = (debtors[i] == user) & (offset < span);
+            buckets[hit ? offset / period : periodCount] += amounts[i];
+        }
+        vector<Money> spend(periodCount);
+        for (size_t k = 0; k < periodCount; k++) {
+            spend[k] = Money(buckets[k]);
+        }
+        return spend;
+    }
+
+    // The `count` users who paid the most, by total amount of the expenses they paid
+    vector<pair<UserIndex, Money>> topPayers(size_t count) const {
+        shared_lock<shared_mutex> lock(mutex);
+        vector<int64_t> paid(IdInterner::users().size());
+        for (size_t i = 0; i < amounts.size(); i++) {
+            paid[payers[i]] += amounts[i];
+        }
+        vector<pair<UserIndex, Money>> payersByAmount;
+        for (size_t user = 0; user < paid.size(); user++) {
+            if (paid[user] != 0) payersByAmount.push_back({(UserIndex)user, Money(paid[user])});
+        }
+        count = min(count, payersByAmount.size());
+        partial_sort(payersByAmount.begin(), payersByAmount.begin() + count, payersByAmount.end(),
+                     [](const pair<UserIndex, Money>& a, const pair<UserIndex, Money>& b) {
+                         return a.second != b.second ? a.second > b.second : a.first < b.first;
+                     });
+        payersByAmount.resize(count);
+        return payersByAmount;
+    }
+};
+
+// Little helpers for the snapshot file format
+struct ByteWriter {
+    vector<char> bytes;
+
+    void u32(uint32_t value) {
+        bytes.insert(bytes.end(), (char*)&value, (char*)&value + sizeof(value));
+    }
+    void u64(uint64_t value) {
+        bytes.insert(bytes.end(), (char*)&value, (char*)&value + sizeof(value));
+    }
+    void str(const string& value) {
+        u32(value.size());
+        bytes.insert(bytes.end(), value.begin(), value.end());
+    }
+    void raw(const void* data, size_t size) {
+        bytes.insert(bytes.end(), (const char*)data, (const char*)data + size);
+    }
+};
+
+struct ByteReader {
+    const char* data;
+    size_t size;
+    size_t pos = 0;
+
+    ByteReader(const char* data, size_t size) : data(data), size(size) {}
+
+    void need(size_t count) {
+        if (pos + count > size) throw runtime_error("snapshot is truncated");
+    }
+    uint32_t u32() {
+        uint32_t value;
+        need(sizeof(value));
+        memcpy(&value, data + pos, sizeof(value));
+        pos += sizeof(value);
+        return value;
+    }
+    uint64_t u64() {
+        uint64_t value;
+        need(sizeof(value));
+        memcpy(&value, data + pos, sizeof(value));
+        pos += sizeof(value);
+        return value;
+    }
+    string str() {
+        uint32_t length = u32();
+        need(length);
+        string value(data + pos, length);
+        pos += length;
+        return value;
+    }
+    void raw(void* out, size_t size) {
+        need(size);
+        memcpy(out, data + pos, size);
+        pos += size;
+    }
+};
+
+// Row count, then whole columns. Users are stored as id numbers because interned
+// indexes are only meaningful within one process.
+void ExpenseColumns::save(ByteWriter& out) const {
+    shared_lock<shared_mutex> lock(mutex);
+    const IdInterner& ids = IdInterner::users();
+    vector<uint32_t> numberOf(ids.size(), 0);
+    auto numbers = [&](const vector<UserIndex>& users) {
+        vector<uint32_t> column(users.size());
+        for (size_t i = 0; i < users.size(); i++) {
+            uint32_t& number = numberOf[users[i]];
+            if (!number) number = idNumber(ids.idOf(users[i]));
+            column[i] = number;
+        }
+        out.raw(column.data(), column.size() * sizeof(uint32_t));
+    };
+    out.u64(amounts.size());
+    out.raw(amounts.data(), amounts.size() * sizeof(int64_t));
+    numbers(payers);
+    numbers(debtors);
+    out.raw(groups.data(), groups.size() * sizeof(uint32_t));
+    out.raw(timestamps.data(), timestamps.size() * sizeof(int64_t));
+}
+
+void ExpenseColumns::load(ByteReader& in) {
+    uint64_t count = in.u64();
+    const size_t rowBytes = 2 * sizeof(int64_t) + 3 * sizeof(uint32_t);
+    if (count > (in.size - in.pos) / rowBytes) throw runtime_error("snapshot is truncated");
+    UserNumbers users;
+    auto indexes = [&](vector<UserIndex>& column) {
+        column.resize(count);
+        in.raw(column.data(), count * sizeof(uint32_t));
+        for (UserIndex& user : column) user = users(user);
+    };
+    unique_lock<shared_mutex> lock(mutex);
+    amounts.resize(count);
+    in.raw(amounts.data(), count * sizeof(int64_t));
+    indexes(payers);
+    indexes(debtors);
+    groups.resize(count);
+    in.raw(groups.data(), count * sizeof(uint32_t));
+    timestamps.resize(count);
+    in.raw(timestamps.data(), count * sizeof(int64_t));
+}
+
+// Append-only binary ledger of every state change.
+//   <path>.log  fixed-size 32 byte records
+//   <path>.str  string table (names, emails, descriptions) referenced by offset
+//   <path>.snap latest checkpoint, see Splitwise::checkpoint()
+// Appends are buffered and written with write(); flush() pushes the string table before
+// the records so a record on disk never points past the end of the string table.
+// Recovery maps both files with mmap and replays records (Splitwise::openLedger).
+// All methods are safe to call from several threads; an expense and its splits are
+// always appended as one contiguous run.
+class ExpenseLedger {
+public:
+    enum RecordType : uint32_t {
+        CREATE_USER = 1,       // text = name, a/b = offset/length of email
+        CREATE_GROUP,          // text = name
+        ADD_MEMBER,            // a = group, b = user
+        REMOVE_MEMBER,         // a = group, b = user
+        GROUP_EXPENSE,         // a = group, b = payer, c = split count, amount, text = description
+        SPLIT,                 // a = user, b = expense number, c = timestamp, amount; follows an expense record
+        GROUP_SETTLEMENT,      // a = group, b = from, c = to, amount
+        INDIVIDUAL_EXPENSE,    // a = payer, b = other user, c = split count, amount, text = description
+        INDIVIDUAL_SETTLEMENT, // a = from, b = to, amount
+        SIMPLIFY               // a = group, b = SimplifyMode
+    };
+
+    // Users and groups are stored by the number in their id ("user12" -> 12)
+    struct Record {
+        uint32_t type;
+        uint32_t a;
+        uint32_t b;
+        uint32_t c;
+        int64_t amount;
+        uint32_t textOffset;
+        uint32_t textLength;
+    };
+
+    // Read-only view of the files for recovery
+    struct Mapping {
+        const Record* records = nullptr;
+        size_t count = 0;
+        const char* strings = nullptr;
+        size_t stringSize = 0;
+        void* logAddress = nullptr;
+        size_t logBytes = 0;
+        void* stringAddress = nullptr;
+        size_t stringBytes = 0;
+
+        ~Mapping() {
+            if (logAddress) munmap(logAddress, logBytes);
+            if (stringAddress) munmap(stringAddress, stringBytes);
+        }
+
+        // Text of a record, or false if it points outside the string table (torn write)
+        bool text(const Record& record, string& out) const {
+            return slice(record.textOffset, record.textLength, out);
+        }
+
+        bool slice(uint32_t offset, uint32_t length, string& out) const {
+            if ((uint64_t)offset + length > stringSize) return false;
+            out.assign(strings + offset, length);
+            return true;
+        }
+    };
+
+private:
+    static const size_t FLUSH_BYTES = 1 << 16;
+
+    string path;
+    int logFd;
+    int stringFd;
+    uint64_t persistedRecords;  // records already written to <path>.log
+    uint64_t stringBytes;       // string table size including the buffered part
+    vector<Record> recordBuffer;
+    string stringBuffer;
+    uint64_t sinceCheckpoint = 0;
+    mutable mutex appendMutex;
+
+    static void writeAll(int fd, const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t written = ::write(fd, data, size);
+            if (written < 0) throw runtime_error(string("ledger write failed: ") + strerror(errno));
+            data += written;
+            size -= written;
+        }
+    }
+
+    static void* mapFile(int fd, size_t size) {
+        if (size == 0) return nullptr;
+        void* address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address == MAP_FAILED) throw runtime_error(string("ledger mmap failed: ") + strerror(errno));
+        return address;
+    }
+
+public:
+    explicit ExpenseLedger(const string& path) : path(path) {
+        logFd = open((path + ".log").c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+        stringFd = open((path + ".str").c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+        if (logFd < 0 || stringFd < 0) {
+            throw runtime_error("cannot open ledger " + path + ": " + strerror(errno));
+        }
+        struct stat info;
+        fstat(logFd, &info);
+        persistedRecords = info.st_size / sizeof(Record);
+        if (info.st_size % sizeof(Record) != 0) {
+            truncate(persistedRecords); // partial record from a crash mid-write
+        }
+        fstat(stringFd, &info);
+        stringBytes = info.st_size;
+    }
+
+    ~ExpenseLedger() {
+        flush();
+        close(logFd);
+        close(stringFd);
+    }
+
+    const string& getPath() const {
+        return path;
+    }
+
+private:
+    // The *Locked helpers expect appendMutex to be held
+    uint32_t addStringLocked(const string& text) {
+        if (stringBytes + text.size() > UINT32_MAX) {
+            throw runtime_error("ledger string table is full");
+        }
+        uint32_t offset = stringBytes;
+        stringBuffer += text;
+        stringBytes += text.size();
+        return offset;
+    }
+
+    void appendLocked(RecordType type, uint32_t a, uint32_t b, uint32_t c, Money amount, const string& text) {
+        Record record = {type, a, b, c, amount.paise, 0, (uint32_t)text.size()};
+        if (!text.empty()) {
+            record.textOffset = addStringLocked(text);
+        }
+        recordBuffer.push_back(record);
+        sinceCheckpoint++;
+        if (recordBuffer.size() * sizeof(Record) + stringBuffer.size() >= FLUSH_BYTES) {
+            flushLocked();
+        }
+    }
+
+    void flushLocked() {
+        if (!stringBuffer.empty()) {
+            writeAll(stringFd, stringBuffer.data(), stringBuffer.size());
+            stringBuffer.clear();
+        }
+        if (!recordBuffer.empty()) {
+            writeAll(logFd, (const char*)recordBuffer.data(), recordBuffer.size() * sizeof(Record));
+            persistedRecords += recordBuffer.size();
+            recordBuffer.clear();
+        }
+    }
+
+public:
+    uint32_t addString(const string& text) {
+        lock_guard<mutex> lock(appendMutex);
+        return addStringLocked(text);
+    }
+
+    void append(RecordType type, uint32_t a, uint32_t b = 0, uint32_t c = 0,
+                Money amount = Money(), const string& text = "") {
+        lock_guard<mutex> lock(appendMutex);
+        appendLocked(type, a, b, c, amount, text);
+    }
+
+    // Expense header followed by one SPLIT record per split
+    void appendExpense(RecordType type, uint32_t a, uint32_t b, const Expense& expense) {
+        lock_guard<mutex> lock(appendMutex);
+        appendLocked(type, a, b, expense.splits.size(), expense.totalAmount, expense.description);
+        for (const Split& split : expense.splits) {
+            appendLocked(SPLIT, idNumber(split.userId()), idNumber(expense.expenseId), (uint32_t)expense.timestamp,
+                         split.amount, "");
+        }
+    }
+
+    void flush() {
+        lock_guard<mutex> lock(appendMutex);
+        flushLocked();
+    }
+
+    // Durable up to here
+    void sync() {
+        lock_guard<mutex> lock(appendMutex);
+        flushLocked();
+        if (fdatasync(stringFd) != 0 || fdatasync(logFd) != 0) {
+            throw runtime_error(string("ledger sync failed: ") + strerror(errno));
+        }
+    }
+
+    uint64_t recordCount() const {
+        lock_guard<mutex> lock(appendMutex);
+        return persistedRecords + recordBuffer.size();
+    }
+
+    uint64_t recordsSinceCheckpoint() const {
+        lock_guard<mutex> lock(appendMutex);
+        return sinceCheckpoint;
+    }
+
+    void checkpointWritten() {
+        lock_guard<mutex> lock(appendMutex);
+        sinceCheckpoint = 0;
+    }
+
+    void map(Mapping& mapping) {
+        lock_guard<mutex> lock(appendMutex);
+        flushLocked();
+        mapping.count = persistedRecords;
+        mapping.logBytes = persistedRecords * sizeof(Record);
+        mapping.logAddress = mapFile(logFd, mapping.logBytes);
+        mapping.records = (const Record*)mapping.logAddress;
+        mapping.stringBytes = mapping.stringSize = stringBytes;
+        mapping.stringAddress = mapFile(stringFd, mapping.stringBytes);
+        mapping.strings = (const char*)mapping.stringAddress;
+    }
+
+    // Drop a torn tail (partial record or incomplete expense) found during recovery
+    void truncate(uint64_t records) {
+        lock_guard<mutex> lock(appendMutex);
+        flushLocked();
+        if (ftruncate(logFd, records * sizeof(Record)) != 0) {
+            throw runtime_error(string("ledger truncate failed: ") + strerror(errno));
+        }
+        persistedRecords = records;
+    }
+};
+static_assert(sizeof(ExpenseLedger::Record) == 32, "ledger records are 32 bytes");
+
+// Epoch-based reclamation for objects that lock-free readers may still be using.
+// A reader pins the global epoch with a Guard for as long as it holds pointers; an
+// object retired at epoch E is freed once every pinned epoch is newer than E.
+// One process-wide domain, each thread claims a slot on its first Guard.
+class EpochDomain {
+private:
+    static const size_t MAX_THREADS = 256;
+    static const uint64_t IDLE = UINT64_MAX;
+
+    struct alignas(64) Slot {
+        atomic<uint64_t> epoch{IDLE};
+        atomic<bool> taken{false};
+    };
+
+    struct Retired {
+        uint64_t epoch;
+        const void* object;
+        void (*destroy)(const void*);
+    };
+
+    // This thread's slot, released again when the thread exits
+    struct ThreadState {
+        Slot* slot = nullptr;
+        int depth = 0; // nested guards pin only once
+        ~ThreadState() {
+            if (slot) slot->taken.store(false);
+        }
+    };
+
+    atomic<uint64_t> globalEpoch{1};
+    Slot slots[MAX_THREADS];
+    mutex retireMutex;
+    vector<Retired> retired;
+    size_t reclaimAt = 64;
+
+    EpochDomain() {}
+
+    ThreadState& threadState() {
+        static thread_local ThreadState state;
+        if (!state.slot) {
+            for (Slot& slot : slots) {
+                bool expected = false;
+                if (slot.taken.compare_exchange_strong(expected, true)) {
+                    state.slot = &slot;
+                    break;
+                }
+            }
+            if (!state.slot) throw runtime_error("too many reader threads");
+        }
+        return state;
+    }
+
+    // Called with retireMutex held
+    void reclaim() {
+        globalEpoch.fetch_add(1);
+        uint64_t oldestPinned = IDLE;
+        for (Slot& slot : slots) {
+            oldestPinned = min(oldestPinned, slot.epoch.load());
+        }
+        size_t kept = 0;
+        for (Retired& item : retired) {
+            if (item.epoch < oldestPinned) {
+                item.destroy(item.object);
+            } else {
+                retired[kept++] = item;
+            }
+        }
+        retired.resize(kept);
+        reclaimAt = max<size_t>(64, kept * 2);
+    }
+
+public:
+    class Guard {
+    private:
+        ThreadState& state;
+
+    public:
+        Guard() : state(instance().threadState()) {
+            if (state.depth++ == 0) {
+                state.slot->epoch.store(instance().globalEpoch.load());
+            }
+        }
+
+        ~Guard() {
+            if (--state.depth == 0) {
+                state.slot->epoch.store(IDLE, memory_order_release);
+            }
+        }
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+    };
+
+    ~EpochDomain() {
+        for (Retired& item : retired) {
+            item.destroy(item.object);
+        }
+    }
+
+    // Call after the object has been unlinked from everything readers can reach
+    template <typename T>
+    void retire(const T* object) {
+        lock_guard<mutex> lock(retireMutex);
+        retired.push_back({globalEpoch.load(), object, [](const void* p) { delete (const T*)p; }});
+        if (retired.size() >= reclaimAt) {
+            reclaim();
+        }
+    }
+
+    static EpochDomain& instance() {
+        static EpochDomain domain;
+        return domain;
+    }
+};
+
+// Group class --> Concrete Observable
+class Group {
+private:
+    User* getUserByuserId(const string& userId) {
+        return getMember(IdInterner::users().find(userId));
+    }
+
+    // O(1): members[] is aligned with the balance table's slots
+    User* getMember(UserIndex user) {
+        uint32_t slot = groupBalances.slotOf(user);
+        return (slot != BalanceTable::NO_SLOT) ? members[slot] : nullptr;
+    }
+
+public:
+    // One member's balances as published to readers; immutable once published
+    struct BalanceRow {
+        User* member;
+        vector<pair<UserIndex, Money>> entries; // sorted by user index
+    };
+
+    // Membership as published to readers, shared by snapshots until it changes
+    struct MemberDirectory {
+        vector<User*> members;             // sorted by user index (creation order)
+        FlatIndexMap<uint32_t> positionOf; // user index -> position in members
+    };
+
+    // Row pointers aligned with directory->members, shared by every snapshot that only
+    // patches a few rows on top of it
+    struct RowTable {
+        vector<const BalanceRow*> rows;
+    };
+
+    // Immutable, versioned copy of the balance table. A new version is published with an
+    // atomic pointer swap after every change and shares all unchanged rows with the old one:
+    // rows changed since the base table was built are listed as patches, so a write copies
+    // O(changed rows) pointers rather than one per member.
+    struct BalanceSnapshot {
+        uint64_t version;
+        const MemberDirectory* directory;
+        const RowTable* base;
+        vector<pair<uint32_t, const BalanceRow*>> patches; // position -> row, sorted, override base
+
+        const BalanceRow* rowAt(uint32_t position) const {
+            auto patch = lower_bound(patches.begin(), patches.end(), position,
+                                     [](const pair<uint32_t, const BalanceRow*>& p, uint32_t at) {
+                                         return p.first < at;
+                                     });
+            return (patch != patches.end() && patch->first == position) ? patch->second : base->rows[position];
+        }
+
+        const BalanceRow* rowOf(UserIndex user) const {
+            if (user == IdInterner::NOT_FOUND) return nullptr;
+            const uint32_t* position = directory->positionOf.find(user);
+            return position ? rowAt(*position) : nullptr;
+        }
+
+        // Rows in member order
+        template <typename Visit>
+        void forEachRow(Visit visit) const {
+            auto patch = patches.begin();
+            for (uint32_t position = 0; position < base->rows.size(); position++) {
+                if (patch != patches.end() && patch->first == position) {
+                    visit((patch++)->second);
+                } else {
+                    visit(base->rows[position]);
+                }
+            }
+        }
+    };
+
+    // Pins the snapshot current at construction; reads through it take no lock and
+    // copy nothing. Keep it on the stack of one thread and short-lived.
+    class BalanceReader {
+    private:
+        EpochDomain::Guard guard;
+        const BalanceSnapshot* snapshot;
+
+    public:
+        explicit BalanceReader(const atomic<const BalanceSnapshot*>& published)
+            : snapshot(published.load()) {}
+
+        const BalanceSnapshot* operator->() const {
+            return snapshot;
+        }
+    };
+
+private:
+    // Writer side of the snapshots, all under groupMutex
+    atomic<const BalanceSnapshot*> published{nullptr};
+    uint64_t version = 0;
+    vector<UserIndex> staleRows;   // members whose row changed since the last publish
+    bool allRowsStale = true;
+    bool membershipChanged = true;
+    bool deferPublishing = false;  // bulk loading, see setDeferredPublishing()
+
+    void markStale(UserIndex user) {
+        if (!allRowsStale) staleRows.push_back(user);
+    }
+
+    // Balance change without publishing; callers publish() once they are done
+    void applyBalance(UserIndex from, UserIndex to, Money amount) {
+        groupBalances.add(from, to, amount);
+        markStale(from);
+        markStale(to);
+    }
+
+    BalanceRow* buildRow(User* member) const {
+        BalanceRow* row = new BalanceRow{member, {}};
+        const FlatIndexMap<Money>* balances = groupBalances.find(member->index);
+        row->entries.reserve(balances->size());
+        balances->forEach([&](uint32_t other, Money amount) {
+            row->entries.push_back({other, amount});
+        });
+        sort(row->entries.begin(), row->entries.end());
+        return row;
+    }
+
+    // Publish the current balances: rebuild stale rows, share the rest, swap the
+    // pointer and retire whatever the new version no longer references
+    void publish() {
+        if (deferPublishing) return;
+        const BalanceSnapshot* previous = published.load(memory_order_relaxed);
+        BalanceSnapshot* next = new BalanceSnapshot();
+        next->version = ++version;
+
+        if (membershipChanged) {
+            MemberDirectory* directory = new MemberDirectory();
+            directory->members = members;
+            sort(directory->members.begin(), directory->members.end(), [](User* a, User* b) {
+                return a->index < b->index;
+            });
+            for (uint32_t i = 0; i < directory->members.size(); i++) {
+                directory->positionOf[directory->members[i]->index] = i;
+            }
+            next->directory = directory;
+        } else {
+            next->directory = previous->directory;
+        }
+
+        vector<const BalanceRow*> retiredRows;
+        if (allRowsStale || membershipChanged) {
+            // Rows are matched by member, keeping the unchanged ones
+            sort(staleRows.begin(), staleRows.end());
+            RowTable* base = new RowTable();
+            base->rows.reserve(next->directory->members.size());
+            for (User* member : next->directory->members) {
+                const BalanceRow* old = previous ? previous->rowOf(member->index) : nullptr;
+                bool stale = allRowsStale || !old || binary_search(staleRows.begin(), staleRows.end(), member->index);
+                base->rows.push_back(stale ? buildRow(member) : old);
+            }
+            next->base = base;
+            if (previous) {
+                previous->forEachRow([&](const BalanceRow* old) {
+                    if (next->rowOf(old->member->index) != old) retiredRows.push_back(old);
+                });
+            }
+        } else {
+            // Same positions as before: keep the base table and patch the stale rows on top.
+            // Positions follow user index order, so the new patches come out sorted.
+            sort(staleRows.begin(), staleRows.end());
+            staleRows.erase(unique(staleRows.begin(), staleRows.end()), staleRows.end());
+            vector<pair<uint32_t, const BalanceRow*>> changed;
+            for (UserIndex user : staleRows) {
+                const uint32_t* position = next->directory->positionOf.find(user);
+                if (!position) continue; // a row nobody added as a member has nothing to publish
+                const BalanceRow* old = previous->rowAt(*position);
+                retiredRows.push_back(old);
+                changed.push_back({*position, buildRow(old->member)});
+            }
+
+            auto kept = previous->patches.begin();
+            next->patches.reserve(previous->patches.size() + changed.size());
+            for (const auto& patch : changed) {
+                while (kept != previous->patches.end() && kept->first < patch.first) next->patches.push_back(*kept++);
+                if (kept != previous->patches.end() && kept->first == patch.first) kept++;
+                next->patches.push_back(patch);
+            }
+            next->patches.insert(next->patches.end(), kept, previous->patches.end());
+
+            // Fold the patches into a new base once lookups through them cost more than
+            // the occasional full copy: about sqrt(members) patches
+            size_t memberCount = previous->base->rows.size();
+            if (next->patches.size() > max<size_t>(32, (size_t)sqrt((double)memberCount))) {
+                RowTable* base = new RowTable(*previous->base);
+                for (const auto& patch : next->patches) {
+                    base->rows[patch.first] = patch.second;
+                }
+                next->base = base;
+                next->patches.clear();
+            } else {
+                next->base = previous->base;
+            }
+        }
+
+        published.store(next);
+        if (previous) {
+            // Base rows shadowed by a patch were retired when the patch was made
+            EpochDomain& epochs = EpochDomain::instance();
+            if (previous->directory != next->directory) epochs.retire(previous->directory);
+            if (previous->base != next->base) epochs.retire(previous->base);
+            for (const BalanceRow* row : retiredRows) epochs.retire(row);
+            epochs.retire(previous);
+        }
+        staleRows.clear();
+        allRowsStale = false;
+        membershipChanged = false;
+    }
+    
+public:
+    static atomic<int> nextGroupId;
+    string groupId;
+    string name;
+    vector<User*> members; //observers, indexed by groupBalances slot
+    map<string, Expense*> groupExpenses; // Group's own expense book
+    BalanceTable groupBalances; // memberIndex -> {otherMemberIndex -> balance}
+
+    // Async delivery (nullptr = notify synchronously); the recipient list handed to the
+    // dispatcher is shared and only rebuilt after membership changes
+    NotificationDispatcher* dispatcher = nullptr;
+    shared_ptr<const vector<Observer*>> observerSnapshot;
+
+    // Every successful mutation is appended here (nullptr = not persisted)
+    ExpenseLedger* ledger = nullptr;
+
+    // Every booked split is also recorded here for statements (nullptr = not recorded)
+    ExpenseColumns* history = nullptr;
+
+    // Involved users of the expense being added, reused to avoid an allocation per expense
+    vector<UserIndex> involvedScratch;
+
+    // Held by Splitwise around every mutation of this group. Readers go through
+    // readBalances() instead and never wait for it.
+    mutable mutex groupMutex;
+
+    // Settlement state kept up to date from the balance table's dirty set:
+    // members with a non-zero net, and the plan last computed from them
+    FlatIndexMap<Money> openPositions;
+    vector<Transfer> settlementPlan;
+    bool planValid = false;
+    SimplifyMode planMode = SimplifyMode::AUTO;
+    bool balancesSimplified = true; // balances already equal settlementPlan
+    
+    Group(const string& name) {
+        this->groupId = "group" + std::to_string(++nextGroupId);
+        this->name = name;
+        publish();
+    }
+    
+    ~Group() {
+        // Clean up group's expenses
+        for (auto& pair : groupExpenses) {
+            delete pair.second;
+        }
+        // Older versions are owned by the epoch domain; the current one is ours
+        const BalanceSnapshot* snapshot = published.load();
+        snapshot->forEachRow([](const BalanceRow* row) {
+            delete row;
+        });
+        delete snapshot->base;
+        delete snapshot->directory;
+        delete snapshot;
+    }
+    
+    void addMember(User* user) {
+        if (isMember(user->userId)) return;
+
+        // Initialize balance row for new member; its slot is the member's observer slot
+        groupBalances.addRow(user->index);
+        members.push_back(user);
+        observerSnapshot.reset();
+        membershipChanged = true;
+        publish();
+        if (ledger) ledger->append(ExpenseLedger::ADD_MEMBER, idNumber(groupId), idNumber(user->userId));
+        Event event(EventType::MEMBER_ADDED);
+        event.user = &user->name;
+        event.group = &name;
+        EventSink::current().record(event);
+    }
+    
+    bool removeMember(const string& userId) {    
+        // Check if user can be removed or not
+        if(!canUserLeaveGroup(userId)) {
+            Event event(EventType::LEAVE_REFUSED);
+            event.user = &getUserByuserId(userId)->name;
+            event.group = &name;
+            EventSink::current().record(event);
+            return false;
+        }
+        
+        // Remove from group balances (and from other members' rows), then
+        // swap-and-pop the observer list the same way
+        uint32_t slot = groupBalances.removeRow(IdInterner::users().find(userId));
+        members[slot] = members.back();
+        members.pop_back();
+        observerSnapshot.reset();
+        membershipChanged = true;
+        publish();
+        if (ledger) ledger->append(ExpenseLedger::REMOVE_MEMBER, idNumber(groupId), idNumber(userId));
+        return true;
+    }
+    
+    void setDispatcher(NotificationDispatcher* dispatcher) {
+        this->dispatcher = dispatcher;
+    }
+
+    void setLedger(ExpenseLedger* ledger) {
+        this->ledger = ledger;
+    }
+
+    void setHistory(ExpenseColumns* history) {
+        this->history = history;
+    }
+
+    // While deferred, changes are not published; turning it off publishes once.
+    // Used while recovering from the ledger, before any reader can see the group.
+    void setDeferredPublishing(bool deferred) {
+        deferPublishing = deferred;
+        if (deferred) {
+            allRowsStale = true;
+            staleRows.clear();
+        } else {
+            publish();
+        }
+    }
+
+    // Members only see notifications through the event sink, so callers skip building
+    // the message when the sink drops everything
+    void notifyMembers(const string& message) {
+        if (dispatcher) {
+            if (!observerSnapshot) {
+                observerSnapshot = make_shared<const vector<Observer*>>(members.begin(), members.end());
+            }
+            dispatcher->publish(observerSnapshot, message);
+            return;
+        }
+        for (Observer* observer : members) {
+            observer->update(message);
+        }
+    }
+
+    bool isMember(const string& userId) {
+        return groupBalances.contains(IdInterner::users().find(userId));
+    }
+    
+    // Update balance within group
+    void updateGroupBalance(const string& fromUserId, const string& toUserId, Money amount) {
+        const IdInterner& ids = IdInterner::users();
+        updateGroupBalance(ids.find(fromUserId), ids.find(toUserId), amount);
+    }
+
+    void updateGroupBalance(UserIndex from, UserIndex to, Money amount) {
+        applyBalance(from, to, amount);
+        publish();
+    }
+
+    // Latest published balances, safe to call concurrently with changes
+    BalanceReader readBalances() const {
+        return BalanceReader(published);
+    }
+    
+    // Check if user can leave group.
+    bool canUserLeaveGroup(const string& userId) {
+        if (!isMember(userId)) {
+            throw runtime_error("user is not a part of this group");
+        };
+        
+        // Check if user has any outstanding balance with other group members
+        // Settled entries are erased, so any remaining entry is an outstanding balance
+        return groupBalances.find(IdInterner::users().find(userId))->empty();
+    }
+    
+    // Get user's balance within this group (safe to call concurrently with changes)
+    map<string, Money> getUserGroupBalances(const string& userId) {
+        const IdInterner& ids = IdInterner::users();
+        BalanceReader snapshot = readBalances();
+        const BalanceRow* row = snapshot->rowOf(ids.find(userId));
+        if (!row) {
+            throw runtime_error("user is not a part of this group");
+        };
+        map<string, Money> balances;
+        for (const auto& entry : row->entries) {
+            balances[ids.idOf(entry.first)] = entry.second;
+        }
+        return balances;
+    }
+    
+    // Add expense to this group
+    bool addExpense(string& description, Money amount, string& paidByUserId,
+                   vector<string>& involvedUsers, SplitType splitType, 
+                   const vector<double>& splitValues = {}) {
+        
+        const IdInterner& ids = IdInterner::users();
+        if (!groupBalances.contains(ids.find(paidByUserId))) {
+            throw runtime_error("user is not a part of this group");
+        }
+        
+        // Validate that all involved users are group members, resolving each id once
+        involvedScratch.clear();
+        for (const string& userId : involvedUsers) {
+            UserIndex user = ids.find(userId);
+            if (!groupBalances.contains(user)) {
+                throw runtime_error("involvedUsers are not a part of this group");
+            }
+            involvedScratch.push_back(user);
+        }
+        
+        // Generate splits using strategy pattern
+        vector<Split> splits;
+        splits.reserve(involvedScratch.size());
+        SplitFactory::getSplitStrategy(splitType)->calculateSplit(amount, involvedScratch, splitValues, splits);
+        
+        // Create expense in group's own expense book and update group balances
+        Expense* expense = new Expense(description, amount, paidByUserId, move(splits), groupId);
+        applyExpense(expense);
+        if (ledger) ledger->appendExpense(ExpenseLedger::GROUP_EXPENSE, idNumber(groupId), idNumber(paidByUserId), *expense);
+        
+        EventSink& sink = EventSink::current();
+        if (!sink.enabled()) return true;
+
+        Event notifying(EventType::NOTIFYING);
+        notifying.group = &name;
+        sink.record(notifying);
+        notifyMembers("New expense added: " + description + " (Rs " + amount.toString() + ")");
+        
+        vector<const string*> names;
+        for (const string& userId : involvedUsers) {
+            names.push_back(&getUserByuserId(userId)->name);
+        }
+        Event event(EventType::GROUP_EXPENSE);
+        event.group = &name;
+        event.user = &getUserByuserId(paidByUserId)->name;
+        event.text = &description;
+        event.amount = amount;
+        event.names = &names;
+        event.values = &splitValues;
+        sink.record(event);
+        
+        return true;
+    }
+
+    // Book an already split expense (also used when replaying the ledger)
+    void applyExpense(Expense* expense) {
+        groupExpenses[expense->expenseId] = expense;
+        if (history) history->append(*expense);
+
+        UserIndex payer = IdInterner::users().find(expense->paidByUserId);
+        for (const Split& split : expense->splits) {
+            if (split.user != payer) {
+                // Person who paid gets positive balance, person who owes gets negative
+                applyBalance(payer, split.user, split.amount);
+            }
+        }
+        publish();
+    }
+
+    // Batch import: validates every distinct user once, applies the net balance
+    // delta of each (payer, debtor) pair once, and sends one summary notification.
+    // Either the whole batch is applied or (on a validation error) none of it.
+    bool addExpenses(const vector<ExpenseRecord>& records) {
+        const IdInterner& ids = IdInterner::users();
+
+        // Resolve ids and validate membership once per distinct user
+        FlatIndexMap<char> validated;
+        auto resolve = [&](const string& userId) {
+            UserIndex user = ids.find(userId);
+            if (user == IdInterner::NOT_FOUND) {
+                throw runtime_error("user " + userId + " is not a part of this group");
+            }
+            char& seen = validated[user];
+            if (!seen) {
+                if (!groupBalances.contains(user)) {
+                    throw runtime_error("user " + userId + " is not a part of this group");
+                }
+                seen = 1;
+            }
+            return user;
+        };
+        for (const ExpenseRecord& record : records) {
+            if (record.involvedUsers.empty()) {
+                throw runtime_error("expense " + record.description + " involves no users");
+            }
+            resolve(record.paidByUserId);
+            for (const string& userId : record.involvedUsers) {
+                resolve(userId);
+            }
+        }
+
+        // Split every expense; deltas are stored as (lower index, higher index) pairs
+        // so A->B and B->A amounts cancel before touching the table
+        struct Delta {
+            UserIndex from;
+            UserIndex to;
+            Money amount;
+        };
+        vector<Delta> deltas;
+        Money total;
+        for (const ExpenseRecord& record : records) {
+            involvedScratch.clear();
+            for (const string& userId : record.involvedUsers) {
+                involvedScratch.push_back(ids.find(userId));
+            }
+            vector<Split> splits;
+            splits.reserve(involvedScratch.size());
+            SplitFactory::getSplitStrategy(record.splitType)
+                ->calculateSplit(record.amount, involvedScratch, record.splitValues, splits);
+            Expense* expense = new Expense(record.description, record.amount, record.paidByUserId, move(splits), groupId);
+            groupExpenses[expense->expenseId] = expense;
+            if (history) history->append(*expense);
+            total += record.amount;
+            if (ledger) {
+                ledger->appendExpense(ExpenseLedger::GROUP_EXPENSE, idNumber(groupId), idNumber(record.paidByUserId), *expense);
+            }
+
+            UserIndex payer = ids.find(record.paidByUserId);
+            for (const Split& split : expense->splits) {
+                UserIndex debtor = split.user;
+                if (debtor == payer) continue;
+                if (payer < debtor) {
+                    deltas.push_back({payer, debtor, split.amount});
+                } else {
+                    deltas.push_back({debtor, payer, -split.amount});
+                }
+            }
+        }
+
+        // Apply one merged delta per pair
+        sort(deltas.begin(), deltas.end(), [](const Delta& a, const Delta& b) {
+            return a.from != b.from ? a.from < b.from : a.to < b.to;
+        });
+        for (size_t i = 0; i < deltas.size(); ) {
+            Delta merged = deltas[i++];
+            while (i < deltas.size() && deltas[i].from == merged.from && deltas[i].to == merged.to) {
+                merged.amount += deltas[i++].amount;
+            }
+            if (!merged.amount.isZero()) {
+                applyBalance(merged.from, merged.to, merged.amount);
+            }
+        }
+        publish();
+
+        EventSink& sink = EventSink::current();
+        if (sink.enabled()) {
+            notifyMembers(to_string(records.size()) + " new expenses added (Rs " + total.toString() + ")");
+            Event event(EventType::EXPENSES_IMPORTED);
+            event.group = &name;
+            event.count = records.size();
+            event.amount = total;
+            sink.record(event);
+        }
+        return true;
+    }
+    
+    bool settlePayment(string& fromUserId, string& toUserId, Money amount) {
+        // Validate that both users are group members
+        if (!isMember(fromUserId) || !isMember(toUserId)) {
+            Event event(EventType::NOT_A_MEMBER);
+            event.group = &name;
+            EventSink::current().record(event);
+            return false;
+        }
+        
+        // Update group balances
+        updateGroupBalance(fromUserId, toUserId, amount);
+        if (ledger) {
+            ledger->append(ExpenseLedger::GROUP_SETTLEMENT, idNumber(groupId), idNumber(fromUserId), idNumber(toUserId), amount);
+        }
+        
+        EventSink& sink = EventSink::current();
+        if (!sink.enabled()) return true;
+
+        // Get user names for display
+        const string& fromName = getUserByuserId(fromUserId)->name;
+        const string& toName = getUserByuserId(toUserId)->name;
+        
+        // Notify group members
+        notifyMembers("Settlement: " + fromName + " paid " + toName + " Rs " + amount.toString());
+        
+        Event event(EventType::GROUP_SETTLEMENT);
+        event.group = &name;
+        event.user = &fromName;
+        event.other = &toName;
+        event.amount = amount;
+        sink.record(event);
+        
+        return true;
+    }
+    
+    // Renders from the published snapshot, so it is safe to call concurrently with changes
+    void showGroupBalances() {
+        EventSink& sink = EventSink::current();
+        if (!sink.enabled()) return;
+
+        string report = "\n=== Group Balances for " + name + " ===\n";
+        
+        // The snapshot lists members in creation order and sorts every row by index,
+        // so output is stable even though slots are reshuffled by removals
+        BalanceReader snapshot = readBalances();
+        snapshot->forEachRow([&](const BalanceRow* row) {
+            report += row->member->name + "'s balances in group:\n";
+            const vector<pair<UserIndex, Money>>& userBalances = row->entries;
+
+            if (userBalances.empty()) {
+                report += "  No outstanding balances\n";
+            } 
+            else {
+                for (const auto& userBalance : userBalances) {
+                    const string& otherName = snapshot->rowOf(userBalance.first)->member->name;
+                    
+                    Money balance = userBalance.second;
+                    if (balance.paise > 0) {
+                        report += "  " + otherName + " owes: Rs " + balance.toString() + "\n";
+                    } else {
+                        report += "  Owes " + otherName + ": Rs " + balance.abs().toString() + "\n";
+                    }
+                }
+            }
+        });
+
+        Event event(EventType::REPORT);
+        event.group = &name;
+        event.text = &report;
+        sink.record(event);
+    }
+
+    // Settlement plan for the current balances. Only members touched since the last
+    // call are revisited, and the plan is reused as long as no net position changed.
+    const vector<Transfer>& getSettlementPlan(SimplifyMode mode = SimplifyMode::AUTO) {
+        if (groupBalances.hasDirty()) {
+            groupBalances.takeDirty([&](UserIndex user, Money net) {
+                if (net.isZero()) {
+                    openPositions.erase(user);
+                } else {
+                    openPositions[user] = net;
+                }
+            });
+            planValid = false;
+        }
+        if (!planValid || planMode != mode) {
+            vector<pair<UserIndex, Money>> positions;
+            openPositions.forEach([&](uint32_t user, Money net) {
+                positions.push_back({user, net});
+            });
+            sort(positions.begin(), positions.end()); // stable plans regardless of hash order
+
+            vector<UserIndex> users;
+            vector<Money> nets;
+            for (const auto& position : positions) {
+                users.push_back(position.first);
+                nets.push_back(position.second);
+            }
+            settlementPlan = DebtSimplifier::planTransfers(users, nets, mode);
+            planValid = true;
+            planMode = mode;
+            balancesSimplified = false;
+        }
+        return settlementPlan;
+    }
+
+    void simplifyGroupDebts(SimplifyMode mode = SimplifyMode::AUTO) {
+        const vector<Transfer>& plan = getSettlementPlan(mode);
+        // Log what AUTO resolved to, so replay rebuilds this plan whatever the cutoff is then
+        if (ledger) {
+            ledger->append(ExpenseLedger::SIMPLIFY, idNumber(groupId),
+                           (uint32_t)DebtSimplifier::resolve(mode, openPositions.size()));
+        }
+
+        // Replace all balances with the plan; nets are unchanged, so the plan stays valid
+        if (!balancesSimplified) {
+            groupBalances.clearBalances();
+            allRowsStale = true;
+            for (const Transfer& transfer : plan) {
+                applyBalance(transfer.to, transfer.from, transfer.amount);
+            }
+            groupBalances.discardDirty();
+            balancesSimplified = true;
+            publish();
+        }
+    
+        Event event(EventType::DEBTS_SIMPLIFIED);
+        event.group = &name;
+        EventSink::current().record(event);
+    }
+};
+atomic<int> Group::nextGroupId(0);
+    
+// Locks the individual balances of two users; std::lock avoids deadlocking against
+// a thread locking the same pair the other way round
+class UserPairLock {
+private:
+    unique_lock<mutex> first;
+    unique_lock<mutex> second;
+
+public:
+    UserPairLock(User* a, User* b)
+        : first(a->balanceMutex, defer_lock), second(b->balanceMutex, defer_lock) {
+        if (a == b) {
+            first.lock();
+        } else {
+            lock(first, second);
+        }
+    }
+};
+
+// Main ExpenseManager class (Singleton - Facade)
+// Thread-safe: registries are sharded maps, each group is guarded by its own
+// groupMutex and each user's individual balances by balanceMutex, so requests for
+// different groups run in parallel. Lock order: creationMutex, groups, users, ledger.
+class Splitwise {
+private:
+    ShardedMap<User*> users;
+    ShardedMap<Group*> groups;
+    ShardedMap<Expense*> expenses;
+    ExpenseColumns history; // every split ever booked, for statements
+    NotificationDispatcher* dispatcher = nullptr;
+    ExpenseLedger* ledger = nullptr;
+    uint64_t checkpointInterval = 0;
+    mutex creationMutex;   // user/group ids are handed out in ledger order
+    bool recovering = false;
+    mutex checkpointMutex; // one checkpoint at a time
+    uint64_t unloadedExpenses = 0; // ledger records whose Expense objects are not rebuilt yet
+    mutex expenseBooksMutex;
+
+    static Splitwise* instance;
+    Splitwise() {}
+
+    void reportMissing(EventType type, const string& id) {
+        Event event(type);
+        event.text = &id;
+        EventSink::current().record(event);
+    }
+
+    // Call without holding any group or user lock
+    void maybeCheckpoint() {
+        if (ledger && checkpointInterval && ledger->recordsSinceCheckpoint() >= checkpointInterval) {
+            unique_lock<mutex> checkpointing(checkpointMutex, try_to_lock);
+            if (checkpointing.owns_lock()) {
+                writeCheckpoint(); // otherwise another thread is already writing one
+            }
+        }
+    }
+
+    vector<User*> sortedUsers() const {
+        vector<User*> sorted;
+        users.forEach([&](User* user) { sorted.push_back(user); });
+        sort(sorted.begin(), sorted.end(), [](User* a, User* b) {
+            return idNumber(a->userId) < idNumber(b->userId);
+        });
+        return sorted;
+    }
+
+    vector<Group*> sortedGroups() const {
+        vector<Group*> sorted;
+        groups.forEach([&](Group* group) { sorted.push_back(group); });
+        sort(sorted.begin(), sorted.end(), [](Group* a, Group* b) {
+            return idNumber(a->groupId) < idNumber(b->groupId);
+        });
+        return sorted;
+    }
+
+    // Snapshot layout: record count covered, id counters, users with their individual
+    // balances, groups with members (in slot order) and their positive balance entries
+    bool loadSnapshot(ExpenseLedger* source, uint64_t& coveredRecords) {
+        int fd = open((source->getPath() + ".snap").c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        fstat(fd, &info);
+        vector<char> bytes(info.st_size);
+        bool complete = (read(fd, bytes.data(), bytes.size()) == (ssize_t)bytes.size());
+        close(fd);
+        if (!complete) return false;
+
+        ByteReader in(bytes.data(), bytes.size());
+        if (in.u32() != SNAPSHOT_MAGIC) return false;
+        coveredRecords = in.u64();
+        uint32_t userCounter = in.u32();
+        uint32_t groupCounter = in.u32();
+        uint32_t expenseCounter = in.u32();
+
+        UserNumbers users;
+        uint32_t userCount = in.u32();
+        for (uint32_t i = 0; i < userCount; i++) {
+            User::nextUserId = in.u32() - 1;
+            string name = in.str();
+            string email = in.str();
+            User* user = createUser(name, email);
+            uint32_t balanceCount = in.u32();
+            for (uint32_t j = 0; j < balanceCount; j++) {
+                UserIndex other = users(in.u32());
+                user->balances[other] = Money((int64_t)in.u64());
+            }
+        }
+
+        uint32_t groupCount = in.u32();
+        for (uint32_t i = 0; i < groupCount; i++) {
+            Group::nextGroupId = in.u32() - 1;
+            Group* group = createGroup(in.str());
+            uint32_t memberCount = in.u32();
+            for (uint32_t j = 0; j < memberCount; j++) {
+                group->addMember(getUser("user" + to_string(in.u32())));
+            }
+            uint32_t entryCount = in.u32();
+            for (uint32_t j = 0; j < entryCount; j++) {
+                UserIndex creditor = users(in.u32());
+                UserIndex debtor = users(in.u32());
+                group->updateGroupBalance(creditor, debtor, Money((int64_t)in.u64()));
+            }
+        }
+        history.load(in);
+
+        User::nextUserId = userCounter;
+        Group::nextGroupId = groupCounter;
+        Expense::nextExpenseId = expenseCounter;
+        return true;
+    }
+
+    // Rebuilds the expense whose header is records[i]. The id and timestamp ride on the
+    // first split record; an expense without them gets a fresh id.
+    Expense* readExpense(const ExpenseLedger::Mapping& log, uint64_t i, uint64_t length, const string& text,
+                         UserNumbers& users) {
+        const ExpenseLedger::Record& record = log.records[i];
+        vector<Split> splits;
+        splits.reserve(length - 1);
+        for (uint64_t k = 1; k < length; k++) {
+            const ExpenseLedger::Record& split = log.records[i + k];
+            splits.push_back(Split(users(split.a), Money(split.amount)));
+        }
+        bool group = (record.type == ExpenseLedger::GROUP_EXPENSE);
+        string payer = "user" + to_string(group ? record.b : record.a);
+        string groupId = group ? "group" + to_string(record.a) : "";
+        if (length == 1 || log.records[i + 1].b == 0) {
+            return new Expense(text, Money(record.amount), payer, move(splits), groupId);
+        }
+        const ExpenseLedger::Record& first = log.records[i + 1];
+        int64_t timestamp = first.c ? first.c : time(nullptr);
+        return new Expense("expense" + to_string(first.b), timestamp, text, Money(record.amount), payer,
+                           move(splits), groupId);
+    }
+
+    // Re-applies records [fromRecord, end) and cuts off a torn tail
+    void replayLedger(ExpenseLedger* source, uint64_t fromRecord) {
+        ExpenseLedger::Mapping log;
+        source->map(log);
+
+        uint64_t i = fromRecord;
+        uint32_t lastExpense = Expense::nextExpenseId;
+        UserNumbers users;
+        while (i < log.count) {
+            const ExpenseLedger::Record& record = log.records[i];
+            bool hasSplits = (record.type == ExpenseLedger::GROUP_EXPENSE ||
+                              record.type == ExpenseLedger::INDIVIDUAL_EXPENSE);
+            uint64_t length = 1 + (hasSplits ? record.c : 0);
+            string text, email;
+            if (i + length > log.count || !log.text(record, text)) {
+                break;
+            }
+            Money amount(record.amount);
+
+            switch (record.type) {
+                case ExpenseLedger::CREATE_USER:
+                    if (!log.slice(record.a, record.b, email)) break;
+                    createUser(text, email);
+                    break;
+                case ExpenseLedger::CREATE_GROUP:
+                    createGroup(text);
+                    break;
+                case ExpenseLedger::ADD_MEMBER:
+                    addUserToGroup("user" + to_string(record.b), "group" + to_string(record.a));
+                    break;
+                case ExpenseLedger::REMOVE_MEMBER:
+                    removeUserFromGroup("user" + to_string(record.b), "group" + to_string(record.a));
+                    break;
+                case ExpenseLedger::GROUP_EXPENSE:
+                case ExpenseLedger::INDIVIDUAL_EXPENSE: {
+                    // Expenses of different groups may be logged out of id order
+                    Expense* expense = readExpense(log, i, length, text, users);
+                    if (length > 1) lastExpense = max(lastExpense, log.records[i + 1].b);
+                    if (record.type == ExpenseLedger::GROUP_EXPENSE) {
+                        getGroup(expense->groupId)->applyExpense(expense);
+                    } else {
+                        string other = "user" + to_string(record.b);
+                        expenses.insert(expense->expenseId, expense);
+                        history.append(*expense);
+                        getUser(expense->paidByUserId)->updateBalance(other, amount);
+                        getUser(other)->updateBalance(expense->paidByUserId, -amount);
+                    }
+                    break;
+                }
+                case ExpenseLedger::GROUP_SETTLEMENT:
+                    getGroup("group" + to_string(record.a))->updateGroupBalance(
+                        "user" + to_string(record.b), "user" + to_string(record.c), amount);
+                    break;
+                case ExpenseLedger::INDIVIDUAL_SETTLEMENT:
+                    getUser("user" + to_string(record.a))->updateBalance("user" + to_string(record.b), amount);
+                    getUser("user" + to_string(record.b))->updateBalance("user" + to_string(record.a), -amount);
+                    break;
+                case ExpenseLedger::SIMPLIFY:
+                    getGroup("group" + to_string(record.a))->simplifyGroupDebts((SimplifyMode)record.b);
+                    break;
+            }
+            i += length;
+        }
+        Expense::nextExpenseId = max<uint32_t>(Expense::nextExpenseId, lastExpense);
+        if (i < log.count) {
+            source->truncate(i);
+        }
+    }
+    
+public:
+    static Splitwise* getInstance() {
+        static once_flag created;
+        call_once(created, [] { instance = new Splitwise(); });
+        return instance;
+    }
+
+    // User management
+    User* createUser(string name, string email) {
+        User* user;
+        {
+            // The id and the ledger record are taken together so replay reproduces the id
+            lock_guard<mutex> creating(creationMutex);
+            user = new User(name, email);
+            if (ledger) {
+                uint32_t emailOffset = ledger->addString(email);
+                ledger->append(ExpenseLedger::CREATE_USER, emailOffset, email.size(), 0, Money(), name);
+            }
+            users.insert(user->userId, user);
+        }
+        maybeCheckpoint();
+        Event event(EventType::USER_CREATED);
+        event.user = &user->name;
+        event.text = &user->userId;
+        EventSink::current().record(event);
+        return user;
+    }
+    
+    User* getUser(const string& userId) {
+        return users.find(userId);
+    }
+    
+    // Group management
+    Group* createGroup(const string name) {
+        Group* group;
+        {
+            lock_guard<mutex> creating(creationMutex);
+            group = new Group(name);
+            group->setDispatcher(dispatcher);
+            group->setLedger(ledger);
+            group->setHistory(&history);
+            if (recovering) group->setDeferredPublishing(true);
+            if (ledger) {
+                ledger->append(ExpenseLedger::CREATE_GROUP, 0, 0, 0, Money(), name);
+            }
+            groups.insert(group->groupId, group);
+        }
+        maybeCheckpoint();
+        Event event(EventType::GROUP_CREATED);
+        event.group = &group->name;
+        event.text = &group->groupId;
+        EventSink::current().record(event);
+        return group;
+    }
+    
+    Group* getGroup(const string& groupId) {
+        return groups.find(groupId);
+    }
+
+    // Deliver group notifications from a background thread for all groups.
+    // Call before other threads start using the instance.
+    void enableAsyncNotifications(size_t queueCapacity = 4096, BackPressure policy = BackPressure::BLOCK) {
+        if (dispatcher) return;
+        dispatcher = new NotificationDispatcher(queueCapacity, policy);
+        groups.forEach([&](Group* group) {
+            group->setDispatcher(dispatcher);
+        });
+    }
+
+    void flushNotifications() {
+        if (dispatcher) {
+            dispatcher->flush();
+        }
+    }
+
+    // Where every operation reports to (nullptr = console text). The sink is not owned
+    // and must outlive its use; install it before other threads start using the instance.
+    void setEventSink(EventSink* sink) {
+        EventSink::install(sink);
+    }
+
+    void flushEvents() {
+        flushNotifications();
+        EventSink::current().flush();
+    }
+
+    static const uint32_t SNAPSHOT_MAGIC = 0x53574E32; // "SWN2"
+
+    // Persist every change to an append-only ledger at `path`. Existing state is recovered
+    // first: the latest snapshot is loaded and only the records after it are replayed.
+    // Call on a fresh instance, before creating users or groups or starting other threads.
+    void openLedger(const string& path, uint64_t checkpointEvery = 100000) {
+        if (ledger) return;
+        ledger = new ExpenseLedger(path);
+        checkpointInterval = checkpointEvery;
+
+        // Replayed operations run with logging off and events dropped
+        // Snapshots are only published once the whole group has been rebuilt
+        ExpenseLedger* source = ledger;
+        ledger = nullptr;
+        recovering = true;
+        static NullSink silent;
+        EventSink* events = EventSink::install(&silent);
+
+        uint64_t coveredRecords = 0;
+        bool fromSnapshot = loadSnapshot(source, coveredRecords);
+        replayLedger(source, fromSnapshot ? coveredRecords : 0);
+        unloadedExpenses = fromSnapshot ? coveredRecords : 0;
+        ledger = source;
+        recovering = false;
+
+        EventSink::install(events);
+        groups.forEach([&](Group* group) {
+            group->setLedger(ledger);
+            group->setDeferredPublishing(false);
+        });
+    }
+
+    // Write a snapshot of all balances, id counters and the split history so recovery
+    // only replays the records after it. The Expense objects of the expenses before it
+    // are not in the snapshot; they stay in the ledger until loadExpenseBooks().
+    void checkpoint() {
+        if (!ledger) return;
+        lock_guard<mutex> checkpointing(checkpointMutex);
+        writeCheckpoint();
+    }
+
+    // Rebuild the Expense objects that recovery from a checkpoint left in the ledger into
+    // the group and individual expense books. Balances and the split history never need
+    // this; call it before looking old expenses up by id.
+    void loadExpenseBooks() {
+        lock_guard<mutex> loading(expenseBooksMutex);
+        if (!unloadedExpenses) return;
+        ExpenseLedger::Mapping log;
+        ledger->map(log);
+        UserNumbers users;
+        uint64_t i = 0;
+        while (i < unloadedExpenses && i < log.count) {
+            const ExpenseLedger::Record& record = log.records[i];
+            bool hasSplits = (record.type == ExpenseLedger::GROUP_EXPENSE ||
+                              record.type == ExpenseLedger::INDIVIDUAL_EXPENSE);
+            uint64_t length = 1 + (hasSplits ? record.c : 0);
+            string text;
+            // Without splits there is no logged id to file the expense under
+            if (hasSplits && length > 1 && log.text(record, text)) {
+                Expense* expense = readExpense(log, i, length, text, users);
+                if (record.type == ExpenseLedger::GROUP_EXPENSE) {
+                    Group* group = getGroup(expense->groupId);
+                    lock_guard<mutex> lock(group->groupMutex);
+                    group->groupExpenses[expense->expenseId] = expense;
+                } else {
+                    expenses.insert(expense->expenseId, expense);
+                }
+            }
+            i += length;
+        }
+        unloadedExpenses = 0;
+    }
+
+private:
+    // Stops the world: every group and user is locked (in the documented order) so the
+    // snapshot matches the ledger's record count exactly
+    void writeCheckpoint() {
+        lock_guard<mutex> creating(creationMutex);
+        vector<User*> sortedUsers = this->sortedUsers();
+        vector<Group*> sortedGroups = this->sortedGroups();
+        vector<unique_lock<mutex>> held;
+        for (Group* group : sortedGroups) held.emplace_back(group->groupMutex);
+        for (User* user : sortedUsers) held.emplace_back(user->balanceMutex);
+        ledger->sync();
+
+        ByteWriter out;
+        out.u32(SNAPSHOT_MAGIC);
+        out.u64(ledger->recordCount());
+        out.u32(User::nextUserId);
+        out.u32(Group::nextGroupId);
+        out.u32(Expense::nextExpenseId);
+
+        out.u32(sortedUsers.size());
+        for (User* user : sortedUsers) {
+            out.u32(idNumber(user->userId));
+            out.str(user->name);
+            out.str(user->email);
+            out.u32(user->balances.size());
+            user->balances.forEach([&](uint32_t other, Money amount) {
+                out.u32(idNumber(IdInterner::users().idOf(other)));
+                out.u64(amount.paise);
+            });
         }
+
+        const IdInterner& ids = IdInterner::users();
+        out.u32(sortedGroups.size());
+        for (Group* group : sortedGroups) {
+            out.u32(idNumber(group->groupId));
+            out.str(group->name);
+            out.u32(group->members.size());
+            for (User* member : group->members) {
+                out.u32(idNumber(member->userId));
+            }
+            ByteWriter entries;
+            uint32_t entryCount = 0;
+            for (User* member : group->members) {
+                group->groupBalances.find(member->index)->forEach([&](uint32_t other, Money amount) {
+                    if (amount.paise > 0) {
+                        entries.u32(idNumber(member->userId));
+                        entries.u32(idNumber(ids.idOf(other)));
+                        entries.u64(amount.paise);
+                        entryCount++;
+                    }
+                });
+            }
+            out.u32(entryCount);
+            out.bytes.insert(out.bytes.end(), entries.bytes.begin(), entries.bytes.end());
+        }
+        history.save(out);
+
+        // Write beside the old snapshot and rename over it, so a crash leaves one intact
+        string path = ledger->getPath() + ".snap";
+        string temporary = path + ".tmp";
+        int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) throw runtime_error("cannot write snapshot " + temporary);
+        bool written = (write(fd, out.bytes.data(), out.bytes.size()) == (ssize_t)out.bytes.size());
+        written = written && fdatasync(fd) == 0;
+        close(fd);
+        if (!written || rename(temporary.c_str(), path.c_str()) != 0) {
+            throw runtime_error("cannot write snapshot " + path);
+        }
+        ledger->checkpointWritten();
+    }
+
+public:
+    // Make everything logged so far durable
+    void syncLedger() {
+        if (ledger) ledger->sync();
+    }
+    
+    void addUserToGroup(const string& userId, const string& groupId) {
+        User* user = getUser(userId);
+        Group* group = getGroup(groupId);
         
-        // Validate that all involved users are group members
-        for (const string& userId : involvedUsers) {
-            if (!isMember(userId)) {
-                throw runtime_error("involvedUsers are not a part of this group");
+        if (user && group) {
+            {
+                lock_guard<mutex> lock(group->groupMutex);
+                group->addMember(user);
             }
+            maybeCheckpoint();
         }
+    }
+    
+    // Try to remove user from group - just delegates to group
+    bool removeUserFromGroup(const string& userId, const string& groupId) {
+        Group* group = getGroup(groupId);
         
-        // Generate splits using strategy pattern
-        vector<Split> splits = SplitFactory::getSplitStrategy(splitType)
-                                ->calculateSplit(amount, involvedUsers, splitValues);
+        if (!group) {
+            reportMissing(EventType::GROUP_NOT_FOUND, groupId);
+            return false;
+        }
         
-        // Create expense in group's own expense book
-        Expense* expense = new Expense(description, amount, paidByUserId, splits, groupId);
-        groupExpenses[expense->expenseId] = expense;
+        User* user = getUser(userId);
+        if (!user) {
+            reportMissing(EventType::USER_NOT_FOUND, userId);
+            return false;
+        }
+
+        bool userRemoved;
+        {
+            lock_guard<mutex> lock(group->groupMutex);
+            userRemoved = group->removeMember(userId);
+        }
+        maybeCheckpoint();
         
-        // Update group balances
-        for (Split& split : splits) {
-            if (split.userId != paidByUserId) {
-                // Person who paid gets positive balance, person who owes gets negative
-                updateGroupBalance(paidByUserId, split.userId, split.amount);
+        if(userRemoved) {
+            Event event(EventType::MEMBER_LEFT);
+            event.user = &user->name;
+            event.group = &group->name;
+            EventSink::current().record(event);
+        }
+        return userRemoved;
+    }
+    
+    // Expense management - delegate to group
+    void addExpenseToGroup(string& groupId, string description, Money amount, 
+                          string& paidByUserId, vector<string>& involvedUsers, 
+                          SplitType splitType, const vector<double>& splitValues = {}) {
+        
+        Group* group = getGroup(groupId);
+        if (!group) {
+            reportMissing(EventType::GROUP_NOT_FOUND, groupId);
+            return;
+        }
+        
+        {
+            lock_guard<mutex> lock(group->groupMutex);
+            group->addExpense(description, amount, paidByUserId, involvedUsers, splitType, splitValues);
+        }
+        maybeCheckpoint();
+    }
+    
+    // Batch expense import - delegate to group
+    void addExpensesToGroup(string& groupId, const vector<ExpenseRecord>& records) {
+        Group* group = getGroup(groupId);
+        if (!group) {
+            reportMissing(EventType::GROUP_NOT_FOUND, groupId);
+            return;
+        }
+
+        {
+            lock_guard<mutex> lock(group->groupMutex);
+            group->addExpenses(records);
+        }
+        maybeCheckpoint();
+    }
+    
+    // Settlement - delegate to group
+    void settlePaymentInGroup(string& groupId, string& fromUserId, 
+                              string& toUserId, Money amount) {
+        
+        Group* group = getGroup(groupId);
+        if (!group) {
+            reportMissing(EventType::GROUP_NOT_FOUND, groupId);
+            return;
+        }
+        
+        {
+            lock_guard<mutex> lock(group->groupMutex);
+            group->settlePayment(fromUserId, toUserId, amount);
+        }
+        maybeCheckpoint();
+    }
+    
+    // Settlement
+    void settleIndividualPayment(string& fromUserId, string& toUserId, Money amount) {
+        User* fromUser = getUser(fromUserId);
+        User* toUser = getUser(toUserId);
+        
+        if (fromUser && toUser) {
+            {
+                UserPairLock lock(fromUser, toUser);
+                fromUser->updateBalance(toUserId, amount);
+                toUser->updateBalance(fromUserId, -amount);
+                if (ledger) {
+                    ledger->append(ExpenseLedger::INDIVIDUAL_SETTLEMENT, idNumber(fromUserId), idNumber(toUserId), 0, amount);
+                }
+            }
+            maybeCheckpoint();
+            
+            Event event(EventType::INDIVIDUAL_SETTLEMENT);
+            event.user = &fromUser->name;
+            event.other = &toUser->name;
+            event.amount = amount;
+            EventSink::current().record(event);
+        }
+    }
+    
+    void addIndividualExpense(string description, Money amount, string paidByUserId,
+                             string toUserId, SplitType splitType,
+                            const vector<double>& splitValues = {}) {
+
+        SplitStrategy* strategy = SplitFactory::getSplitStrategy(splitType);
+        vector<Split> splits = strategy->calculateSplit(amount, {paidByUserId, toUserId}, splitValues);
+
+        Expense* expense = new Expense(description, amount, paidByUserId, move(splits));
+        expenses.insert(expense->expenseId, expense);
+        
+        User* paidByUser = getUser(paidByUserId);
+        User* toUser = getUser(toUserId);
+
+        {
+            // History and ledger record change together, so a checkpoint sees both or neither
+            UserPairLock lock(paidByUser, toUser);
+            history.append(*expense);
+            paidByUser->updateBalance(toUserId, amount);
+            toUser->updateBalance(paidByUserId, -amount);
+            if (ledger) {
+                ledger->appendExpense(ExpenseLedger::INDIVIDUAL_EXPENSE, idNumber(paidByUserId), idNumber(toUserId), *expense);
+            }
+        }
+        maybeCheckpoint();
+        
+        Event event(EventType::INDIVIDUAL_EXPENSE);
+        event.user = &paidByUser->name;
+        event.other = &toUser->name;
+        event.text = &description;
+        event.amount = amount;
+        EventSink::current().record(event);
+    }
+    
+    // Display Method
+    void showUserBalance(string& userId) {
+        User* user = getUser(userId);
+        if (!user) return;
+        EventSink& sink = EventSink::current();
+        if (!sink.enabled()) return;
+        lock_guard<mutex> lock(user->balanceMutex);
+        
+        string report = "\n=========== Balance for " + user->name + " ====================\n";
+        report += "Total you owe: Rs " + user->getTotalOwed().toString() + "\n";
+        report += "Total others owe you: Rs " + user->getTotalOwing().toString() + "\n";
+        
+        report += "Detailed balances:\n";
+        vector<pair<string, Money>> balances; // listed in id order
+        user->balances.forEach([&](uint32_t other, Money amount) {
+            balances.push_back({IdInterner::users().idOf(other), amount});
+        });
+        sort(balances.begin(), balances.end());
+        for (auto& balance : balances) {
+            User* otherUser = getUser(balance.first);
+            if (otherUser) {
+                if (balance.second.paise > 0) {
+                    report += "  " + otherUser->name + " owes you: Rs" + balance.second.toString() + "\n";
+                } else {
+                    report += "  You owe " + otherUser->name + ": Rs" + balance.second.abs().toString() + "\n";
+                }
+            }
+        }
+
+        Event event(EventType::REPORT);
+        event.user = &user->name;
+        event.text = &report;
+        sink.record(event);
+    }
+    
+    void showGroupBalances(string& groupId) {
+        Group* group = getGroup(groupId);
+        if (!group) return;
+        
+        group->showGroupBalances();
+    }
+
+    // One payment plan covering every group and individual balance, so a user who is
+    // owed in one group and owes in another settles only the difference. Groups are
+    // read from their published snapshots, so the plan is consistent per group and
+    // per user but not across a change that lands while it is being built.
+    vector<Transfer> planGlobalSettlement(SimplifyMode mode = SimplifyMode::AUTO, unsigned threads = 0) {
+        GlobalSettlementPlanner planner(IdInterner::users().size());
+        groups.forEach([&](Group* group) {
+            Group::BalanceReader snapshot = group->readBalances();
+            snapshot->forEachRow([&](const Group::BalanceRow* row) {
+                for (const auto& entry : row->entries) {
+                    planner.addBalance(row->member->index, entry.first, entry.second);
+                }
+            });
+        });
+        users.forEach([&](User* user) {
+            lock_guard<mutex> lock(user->balanceMutex);
+            user->balances.forEach([&](uint32_t other, Money amount) {
+                planner.addBalance(user->index, other, amount);
+            });
+        });
+        return planner.plan(mode, threads);
+    }
+
+    // Split history for statements (totals, spend by period, top payers)
+    const ExpenseColumns& getExpenseHistory() const {
+        return history;
+    }
+
+    // Never locks, see Group::readBalances()
+    map<string, Money> getUserGroupBalances(const string& groupId, const string& userId) {
+        Group* group = getGroup(groupId);
+        if (!group) {
+            throw runtime_error("group not found");
+        }
+        return group->getUserGroupBalances(userId);
+    }
+
+    // Zero-copy access to a group's latest balances for as long as the reader lives
+    Group::BalanceReader readGroupBalances(const string& groupId) {
+        Group* group = getGroup(groupId);
+        if (!group) {
+            throw runtime_error("group not found");
+        }
+        return group->readBalances();
+    }
+    
+    void simplifyGroupDebts(string& groupId, SimplifyMode mode = SimplifyMode::AUTO) {
+        Group* group = getGroup(groupId);
+        if (!group) return;
+                
+        // Use group's balance data for debt simplification
+        {
+            lock_guard<mutex> lock(group->groupMutex);
+            group->simplifyGroupDebts(mode);
+        }
+        maybeCheckpoint();
+    }
+};
+
+Splitwise* Splitwise::instance = nullptr;
+
+// ---------------------------- Benchmarks ----------------------------
+
+double elapsedMs(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// Expense ingest into group balances: the old string-keyed map of maps vs BalanceTable
+void benchmarkExpenseIngest() {
+    const int memberCount = 5000;
+    const int expenseCount = 50000;
+    const int splitsPerExpense = 8;
+
+    vector<string> memberIds;
+    for (int i = 0; i < memberCount; i++) {
+        memberIds.push_back("bench" + to_string(i));
+    }
+    mt19937 rng(42);
+    uniform_int_distribution<int> pick(0, memberCount - 1);
+    vector<int> payers, debtors;
+    for (int e = 0; e < expenseCount; e++) {
+        payers.push_back(pick(rng));
+        for (int s = 0; s < splitsPerExpense; s++) {
+            debtors.push_back(pick(rng));
+        }
+    }
+
+    // Before: every update does four string-keyed tree lookups
+    map<string, map<string, double>> legacy;
+    for (const string& id : memberIds) {
+        legacy[id] = map<string, double>();
+    }
+    auto start = chrono::steady_clock::now();
+    for (int e = 0; e < expenseCount; e++) {
+        const string& from = memberIds[payers[e]];
+        for (int s = 0; s < splitsPerExpense; s++) {
+            const string& to = memberIds[debtors[e * splitsPerExpense + s]];
+            if (from == to) continue;
+            legacy[from][to] += 12.5;
+            legacy[to][from] -= 12.5;
+            if (abs(legacy[from][to]) < 0.01) legacy[from].erase(to);
+            if (abs(legacy[to][from]) < 0.01) legacy[to].erase(from);
+        }
+    }
+    double legacyMs = elapsedMs(start);
+
+    // After: interned ids resolved once at the boundary, flat rows on the hot path
+    IdInterner ids;
+    BalanceTable table;
+    vector<UserIndex> indices;
+    for (const string& id : memberIds) {
+        indices.push_back(ids.intern(id));
+        table.addRow(indices.back());
+    }
+    start = chrono::steady_clock::now();
+    for (int e = 0; e < expenseCount; e++) {
+        UserIndex from = indices[payers[e]];
+        for (int s = 0; s < splitsPerExpense; s++) {
+            UserIndex to = indices[debtors[e * splitsPerExpense + s]];
+            if (from == to) continue;
+            table.add(from, to, Money(1250));
+        }
+    }
+    double flatMs = elapsedMs(start);
+
+    cout << memberCount << " members, " << expenseCount << " expenses x " << splitsPerExpense << " splits" << endl;
+    cout << "  map<string, map<string, double>> : " << fixed << setprecision(1) << legacyMs << " ms ("
+         << setprecision(0) << expenseCount / legacyMs * 1000 << " expenses/s)" << endl;
+    cout << "  BalanceTable (interned ids)      : " << setprecision(1) << flatMs << " ms ("
+         << setprecision(0) << expenseCount / flatMs * 1000 << " expenses/s)" << endl;
+}
+
+// Importing an expense CSV: one addExpense per row vs a single addExpenses batch
+void benchmarkBatchImport() {
+    const int memberCount = 1000;
+    const int expenseCount = 20000;
+    const int splitsPerExpense = 6;
+
+    Splitwise* manager = Splitwise::getInstance();
+    streambuf* console = cout.rdbuf(nullptr); // measure the engine, not the terminal
+    vector<string> memberIds;
+    Group* perRow = manager->createGroup("Per-row import");
+    Group* batched = manager->createGroup("Batched import");
+    for (int i = 0; i < memberCount; i++) {
+        User* user = manager->createUser("Bench" + to_string(i), "bench@example.com");
+        memberIds.push_back(user->userId);
+        manager->addUserToGroup(user->userId, perRow->groupId);
+        manager->addUserToGroup(user->userId, batched->groupId);
+    }
+
+    mt19937 rng(7);
+    uniform_int_distribution<int> pick(0, memberCount - 1);
+    vector<ExpenseRecord> records;
+    for (int e = 0; e < expenseCount; e++) {
+        ExpenseRecord record;
+        record.description = "row" + to_string(e);
+        record.amount = Money(100 + rng() % 100000);
+        record.paidByUserId = memberIds[pick(rng)];
+        for (int s = 0; s < splitsPerExpense; s++) {
+            record.involvedUsers.push_back(memberIds[pick(rng)]);
+        }
+        record.splitType = SplitType::EQUAL;
+        records.push_back(record);
+    }
+
+    auto start = chrono::steady_clock::now();
+    for (ExpenseRecord& record : records) {
+        perRow->addExpense(record.description, record.amount, record.paidByUserId,
+                           record.involvedUsers, record.splitType, record.splitValues);
+    }
+    double perRowMs = elapsedMs(start);
+
+    start = chrono::steady_clock::now();
+    batched->addExpenses(records);
+    double batchMs = elapsedMs(start);
+
+    cout.rdbuf(console);
+    cout.clear();
+    cout << memberCount << " members, " << expenseCount << " expenses x " << splitsPerExpense << " splits" << endl;
+    cout << "  addExpense per row : " << fixed << setprecision(1) << perRowMs << " ms" << endl;
+    cout << "  addExpenses batch  : " << batchMs << " ms" << endl;
+}
+
+// addExpense latency in a large group with synchronous vs queued notifications.
+// stdout goes to /dev/null so notifications still pay for real writes.
+void benchmarkAsyncNotifications() {
+    const int expenseCount = 200;
+    Splitwise* manager = Splitwise::getInstance();
+
+    fflush(stdout);
+    int savedStdout = dup(1);
+    int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, 1);
+
+    vector<string> report;
+    for (int memberCount : {100, 10000}) {
+        vector<string> memberIds;
+        Group* syncGroup = manager->createGroup("Sync notifications");
+        Group* asyncGroup = manager->createGroup("Async notifications");
+        for (int i = 0; i < memberCount; i++) {
+            User* user = manager->createUser("Bench" + to_string(i), "bench@example.com");
+            memberIds.push_back(user->userId);
+            syncGroup->addMember(user);
+            asyncGroup->addMember(user);
+        }
+        NotificationDispatcher dispatcher(1024, BackPressure::BLOCK);
+        asyncGroup->setDispatcher(&dispatcher);
+
+        for (Group* group : {syncGroup, asyncGroup}) {
+            mt19937 rng(3);
+            double worstMs = 0;
+            auto start = chrono::steady_clock::now();
+            for (int e = 0; e < expenseCount; e++) {
+                string description = "Snacks";
+                vector<string> involved;
+                for (int k = 0; k < 4; k++) {
+                    involved.push_back(memberIds[rng() % memberCount]);
+                }
+                auto expenseStart = chrono::steady_clock::now();
+                group->addExpense(description, Money(40000), involved[0], involved, SplitType::EQUAL);
+                worstMs = max(worstMs, elapsedMs(expenseStart));
+            }
+            double totalMs = elapsedMs(start);
+            auto flushStart = chrono::steady_clock::now();
+            dispatcher.flush();
+            double flushMs = (group == asyncGroup) ? elapsedMs(flushStart) : 0;
+
+            ostringstream line;
+            line << fixed << setprecision(3) << "  " << setw(5) << memberCount << " members, "
+                 << (group == asyncGroup ? "async" : "sync ") << ": mean " << totalMs / expenseCount
+                 << " ms, worst " << worstMs << " ms per addExpense";
+            if (group == asyncGroup) {
+                line << " (+" << setprecision(1) << flushMs << " ms to drain)";
+            }
+            report.push_back(line.str());
+        }
+        asyncGroup->setDispatcher(nullptr);
+    }
+
+    fflush(stdout);
+    dup2(savedStdout, 1);
+    close(devNull);
+    close(savedStdout);
+    for (const string& line : report) {
+        cout << line << endl;
+    }
+}
+
+// Transfer count and runtime of the simplifiers. Debts are generated in small
+// friend circles (2-5 people), so a transaction-minimal plan exists to be found.
+void benchmarkDebtSimplification() {
+    mt19937 rng(11);
+    IdInterner& ids = IdInterner::users();
+    for (int memberCount : {10, 1000, 100000}) {
+        BalanceTable table;
+        vector<UserIndex> users;
+        for (int i = 0; i < memberCount; i++) {
+            users.push_back(ids.intern("simplify" + to_string(memberCount) + "_" + to_string(i)));
+            table.addRow(users.back());
+        }
+        for (int first = 0; first < memberCount; ) {
+            int size = min<int>(2 + rng() % 4, memberCount - first);
+            for (int k = 0; k < 3 * size; k++) {
+                int a = first + rng() % size, b = first + rng() % size;
+                if (a != b) table.add(users[a], users[b], Money(100 + rng() % 500000));
+            }
+            first += size;
+        }
+        vector<Money> nets;
+        for (UserIndex user : users) {
+            nets.push_back(table.net(user));
+        }
+
+        cout << memberCount << " members:" << endl;
+
+        map<string, map<string, Money>> legacyInput = table.toMap();
+        auto start = chrono::steady_clock::now();
+        map<string, map<string, Money>> legacy = DebtSimplifier::simplifyDebts(legacyInput);
+        double legacyMs = elapsedMs(start);
+        size_t legacyCount = 0;
+        for (const auto& row : legacy) {
+            for (const auto& balance : row.second) {
+                if (balance.second.paise > 0) legacyCount++;
+            }
+        }
+        cout << "  map greedy  : " << setw(7) << legacyCount << " transfers, "
+             << fixed << setprecision(3) << legacyMs << " ms" << endl;
+
+        start = chrono::steady_clock::now();
+        size_t greedyCount = DebtSimplifier::planTransfers(users, nets, SimplifyMode::GREEDY).size();
+        cout << "  heap greedy : " << setw(7) << greedyCount << " transfers, " << elapsedMs(start) << " ms" << endl;
+
+        if (memberCount <= (int)DebtSimplifier::EXACT_CUTOFF) {
+            start = chrono::steady_clock::now();
+            size_t exactCount = DebtSimplifier::planTransfers(users, nets, SimplifyMode::EXACT).size();
+            cout << "  exact       : " << setw(7) << exactCount << " transfers, " << elapsedMs(start) << " ms" << endl;
+        } else {
+            cout << "  exact       : skipped (above " << DebtSimplifier::EXACT_CUTOFF << " members)" << endl;
+        }
+    }
+}
+
+// A settlement screen that asks for the plan on every page view while expenses
+// keep trickling in: full recompute from all rows vs the incrementally maintained plan
+void benchmarkSettlementPageViews() {
+    const int memberCount = 10000;
+    const int rounds = 200;
+    const int viewsPerRound = 20;
+
+    mt19937 rng(5);
+    NullSink silent;
+    EventSink* events = EventSink::install(&silent);
+    Group group("Page views");
+    vector<unique_ptr<User>> viewers;
+    vector<UserIndex> users;
+    group.setDeferredPublishing(true);
+    for (int i = 0; i < memberCount; i++) {
+        viewers.emplace_back(new User("Viewer" + to_string(i), "view@example.com"));
+        group.addMember(viewers.back().get());
+        users.push_back(viewers.back()->index);
+    }
+    group.setDeferredPublishing(false);
+    EventSink::install(events);
+    // Mostly settled group: a few hundred members carry open balances
+    for (int e = 0; e < 300; e++) {
+        group.updateGroupBalance(users[rng() % memberCount], users[rng() % memberCount], Money(100 + rng() % 10000));
+    }
+
+    size_t fullTransfers = 0, incrementalTransfers = 0;
+    double fullMs = 0, incrementalMs = 0;
+    for (int round = 0; round < rounds; round++) {
+        UserIndex payer = users[rng() % memberCount];
+        UserIndex debtor = users[rng() % memberCount];
+        if (payer != debtor) {
+            group.updateGroupBalance(payer, debtor, Money(100 + rng() % 10000));
+        }
+
+        auto start = chrono::steady_clock::now();
+        for (int view = 0; view < viewsPerRound; view++) {
+            vector<UserIndex> all;
+            vector<Money> nets;
+            for (UserIndex user : users) {
+                Money net;
+                group.groupBalances.find(user)->forEach([&](uint32_t, Money amount) {
+                    net += amount;
+                });
+                all.push_back(user);
+                nets.push_back(net);
+            }
+            fullTransfers += DebtSimplifier::planTransfers(all, nets).size();
+        }
+        fullMs += elapsedMs(start);
+
+        start = chrono::steady_clock::now();
+        for (int view = 0; view < viewsPerRound; view++) {
+            incrementalTransfers += group.getSettlementPlan().size();
+        }
+        incrementalMs += elapsedMs(start);
+    }
+
+    int views = rounds * viewsPerRound;
+    cout << memberCount << " members, " << rounds << " expenses, " << viewsPerRound << " views after each" << endl;
+    cout << "  full recompute : " << fixed << setprecision(4) << fullMs / views << " ms per view" << endl;
+    cout << "  incremental    : " << incrementalMs / views << " ms per view"
+         << (fullTransfers == incrementalTransfers ? "" : "  (plans differ!)") << endl;
+}
+
+// Swallows everything written to it, so rendering cost excludes the terminal
+class DiscardBuffer : public streambuf {
+protected:
+    int overflow(int c) override {
+        return c;
+    }
+    streamsize xsputn(const char*, streamsize count) override {
+        return count;
+    }
+};
+
+// Rendering a 10k member group: the old linear member scan per line vs slot lookup
+void benchmarkRenderBalances() {
+    const int memberCount = 10000;
+
+    Splitwise* manager = Splitwise::getInstance();
+    DiscardBuffer discard;
+    streambuf* console = cout.rdbuf(&discard);
+
+    Group* group = manager->createGroup("Render");
+    for (int i = 0; i < memberCount; i++) {
+        User* user = manager->createUser("Member" + to_string(i), "render@example.com");
+        manager->addUserToGroup(user->userId, group->groupId);
+    }
+    mt19937 rng(9);
+    for (int e = 0; e < memberCount; e++) {
+        UserIndex a = group->members[rng() % memberCount]->index;
+        UserIndex b = group->members[rng() % memberCount]->index;
+        if (a != b) group->updateGroupBalance(a, b, Money(100 + rng() % 10000));
+    }
+
+    // Before: the removed linear lookup, once per printed name
+    auto legacyLookup = [&](const string& userId) {
+        User* user = nullptr;
+        for (User* member : group->members) {
+            if (member->userId == userId) {
+                user = member;
             }
         }
-        
-        cout << endl << "=========== Sending Notifications ===================="<<endl;
-        string paidByName = getUserByuserId(paidByUserId)->name;
-        notifyMembers("New expense added: " + description + " (Rs " + to_string(amount) + ")");
-        
-        // Printing console message-------
-        cout << endl << "=========== Expense Message ===================="<<endl;
-        cout << "Expense added to " << name << ": " << description << " (Rs " << amount 
-             << ") paid by " << paidByName <<" and involved people are : "<< endl;
-        if(!splitValues.empty()) {
-            for(int i=0; i<splitValues.size(); i++) {
-                cout << getUserByuserId(involvedUsers[i])->name << " : " << splitValues[i] << endl;
-            }
-        } 
-        else {
-            for(string user : involvedUsers) {
-                cout << getUserByuserId(user)->name << ", ";
-            }
-            cout << endl << "Will be Paid Equally" << endl;
-        }    
-        //-----------------------------------
-        
-        return true;
+        return user;
+    };
+    const IdInterner& ids = IdInterner::users();
+    auto start = chrono::steady_clock::now();
+    for (User* member : group->members) {
+        cout << legacyLookup(member->userId)->name << "'s balances in group:" << endl;
+        group->groupBalances.find(member->index)->forEach([&](uint32_t other, Money amount) {
+            cout << "  " << legacyLookup(ids.idOf(other))->name << " owes: Rs " << amount << endl;
+        });
     }
-    
-    bool settlePayment(string& fromUserId, string& toUserId, double amount) {
-        // Validate that both users are group members
-        if (!isMember(fromUserId) || !isMember(toUserId)) {
-            cout << "user is not a part of this group" << endl;
-            return false;
+    double legacyMs = elapsedMs(start);
+
+    start = chrono::steady_clock::now();
+    group->showGroupBalances();
+    double indexedMs = elapsedMs(start);
+
+    cout.rdbuf(console);
+    cout << memberCount << " members, " << memberCount << " random balances" << endl;
+    cout << "  linear member scan : " << fixed << setprecision(1) << legacyMs << " ms" << endl;
+    cout << "  slot index         : " << indexedMs << " ms" << endl;
+}
+
+// Ledger append cost during ingest, then startup recovery by full replay vs from a
+// snapshot. Recovery needs fresh id counters, so every phase runs in its own process.
+const char* LEDGER_BENCH_PATH = "/tmp/splitwise_bench_ledger";
+
+// One phase of the ledger benchmark, in a process of its own: openLedger needs a fresh
+// Splitwise instance, and the benchmarks run before this one have filled the singleton
+int runLedgerPhase(const string& phase) {
+    const string path = LEDGER_BENCH_PATH;
+    const int memberCount = 1000;
+    const int expenseCount = 100000;
+
+    Splitwise* manager = Splitwise::getInstance();
+    if (phase == "ingest" || phase == "ingest-ledger") {
+        bool persistent = (phase == "ingest-ledger");
+        if (persistent) manager->openLedger(path, 0);
+        NullSink silent;
+        EventSink* events = EventSink::install(&silent);
+        string groupId = manager->createGroup("Ledger")->groupId;
+        vector<string> memberIds;
+        for (int i = 0; i < memberCount; i++) {
+            memberIds.push_back(manager->createUser("Member" + to_string(i), "ledger@example.com")->userId);
+            manager->addUserToGroup(memberIds.back(), groupId);
         }
-        
-        // Update group balances
-        updateGroupBalance(fromUserId, toUserId, amount);
-        
-        // Get user names for display
-        string fromName = getUserByuserId(fromUserId)->name;
-        string toName = getUserByuserId(toUserId)->name;
-        
-        // Notify group members
-        notifyMembers("Settlement: " + fromName + " paid " + toName + " Rs " + to_string(amount));
-        
-        cout << "Settlement in " << name << ": " << fromName << " settled Rs " 
-             << amount << " with " << toName << endl;
-        
-        return true;
+        mt19937 rng(21);
+        auto start = chrono::steady_clock::now();
+        for (int e = 0; e < expenseCount; e++) {
+            vector<string> involved = {memberIds[rng() % memberCount], memberIds[rng() % memberCount],
+                                       memberIds[rng() % memberCount]};
+            manager->addExpenseToGroup(groupId, "Expense " + to_string(e), Money(100 + rng() % 100000),
+                                       involved[0], involved, SplitType::EQUAL);
+        }
+        manager->syncLedger();
+        double ms = elapsedMs(start);
+        EventSink::install(events);
+        cout << "  ingest " << (persistent ? "with ledger   " : "without ledger") << ": " << fixed
+             << setprecision(0) << expenseCount / ms * 1000 << " expenses/s" << endl;
+        return 0;
     }
-    
-    void showGroupBalances() {
-        cout << "\n=== Group Balances for " << name << " ===" << endl;
-        
-        for (const auto& pair : groupBalances) {
-            string memberId = pair.first;
-            string memberName = getUserByuserId(memberId)->name;
 
-            cout << memberName << "'s balances in group:" << endl;
-            
-            auto userBalances = pair.second;
-            if (userBalances.empty()) {
-                cout << "  No outstanding balances" << endl;
-            } 
-            else {
-                for (const auto& userBalance : userBalances) {
-                    string otherMemberUserId = userBalance.first;
-                    string otherName = getUserByuserId(otherMemberUserId)->name;
-                    
-                    double balance = userBalance.second;
-                    if (balance > 0) {
-                        cout << "  " << otherName << " owes: Rs " << fixed << setprecision(2) << balance << endl;
-                    } else {
-                        cout << "  Owes " << otherName << ": Rs " << fixed << setprecision(2) << abs(balance) << endl;
-                    }
-                }
-            }
+    bool fromSnapshot = (phase == "recover-snapshot");
+    auto start = chrono::steady_clock::now();
+    manager->openLedger(path, 0);
+    double ms = elapsedMs(start);
+    Money open;
+    Group* group = manager->getGroup("group1");
+    for (User* member : group->members) {
+        open += group->groupBalances.net(member->index).abs();
+    }
+    cout << "  recovery " << (fromSnapshot ? "from snapshot " : "by full replay") << ": " << fixed
+         << setprecision(1) << ms << " ms (open balances Rs " << open << ", "
+         << manager->getExpenseHistory().size() << " splits)" << endl;
+    if (fromSnapshot) {
+        start = chrono::steady_clock::now();
+        manager->loadExpenseBooks();
+        cout << "  expense books on demand: " << elapsedMs(start) << " ms (" << group->groupExpenses.size()
+             << " expenses)" << endl;
+    } else {
+        manager->checkpoint();
+    }
+    return 0;
+}
+
+void benchmarkLedger() {
+    const string path = LEDGER_BENCH_PATH;
+
+    auto runPhase = [](const char* phase) {
+        cout.flush();
+        pid_t child = fork();
+        if (child == 0) {
+            execl("/proc/self/exe", "main", "ledger-phase", phase, (char*)nullptr);
+            _exit(127);
         }
+        waitpid(child, nullptr, 0);
+    };
+
+    for (const char* suffix : {".log", ".str", ".snap"}) {
+        unlink((path + suffix).c_str());
+    }
+    cout << "1000 members, 100000 expenses x 3 splits" << endl;
+    runPhase("ingest");
+    runPhase("ingest-ledger");
+    runPhase("recover-replay");
+    runPhase("recover-snapshot");
+    for (const char* suffix : {".log", ".str", ".snap"}) {
+        unlink((path + suffix).c_str());
     }
+}
 
-    void simplifyGroupDebts() {
-        map<string, map<string, double>> simplifiedBalances = DebtSimplifier::simplifyDebts(groupBalances);
-        groupBalances = simplifiedBalances;
-    
-        cout << "\nDebts have been simplified for group: " << name << endl;
+// Splitting 8-way expenses: the old string-keyed splits copied into the expense vs
+// index-keyed splits moved into it, and into a reused buffer
+void benchmarkSplitComputation() {
+    const int expenseCount = 1000000;
+    const int splitsPerExpense = 8;
+
+    struct LegacySplit {
+        string userId;
+        Money amount;
+    };
+    IdInterner& ids = IdInterner::users();
+    vector<string> userIds;
+    vector<UserIndex> users;
+    for (int i = 0; i < splitsPerExpense; i++) {
+        userIds.push_back("splitbench_member" + to_string(i));
+        users.push_back(ids.intern(userIds.back()));
     }
-};
-int Group::nextGroupId = 0;
-    
-// Main ExpenseManager class (Singleton - Facade)
-class Splitwise {
-private:
-    map<string, User*> users;
-    map<string, Group*> groups;
-    map<string, Expense*> expenses;
+    SplitStrategy* strategy = SplitFactory::getSplitStrategy(SplitType::EQUAL);
+    int64_t checksum = 0;
 
-    static Splitwise* instance;
-    Splitwise() {}
-    
-public:
-    static Splitwise* getInstance() {
-        if(instance == nullptr) {
-            instance = new Splitwise();
+    // Before: a fresh vector of string splits, then copied again by Expense
+    auto start = chrono::steady_clock::now();
+    for (int e = 0; e < expenseCount; e++) {
+        Money amount(1000 + e % 5000);
+        vector<LegacySplit> splits;
+        int64_t share = amount.paise / splitsPerExpense;
+        for (int i = 0; i < splitsPerExpense; i++) {
+            splits.push_back({userIds[i], Money(share)});
         }
-        return instance;
+        vector<LegacySplit> owned = splits;
+        checksum += owned.back().amount.paise;
     }
+    double legacyMs = elapsedMs(start);
 
-    // User management
-    User* createUser(string name, string email) {
-        User* user = new User(name, email);
-        users[user->userId] = user;
-        cout << "User created: " << name << " (ID: " << user->userId << ")" << endl;
-        return user;
+    start = chrono::steady_clock::now();
+    for (int e = 0; e < expenseCount; e++) {
+        vector<Split> splits;
+        splits.reserve(splitsPerExpense);
+        strategy->calculateSplit(Money(1000 + e % 5000), users, {}, splits);
+        vector<Split> owned = move(splits);
+        checksum += owned.back().amount.paise;
     }
-    
-    User* getUser(const string& userId) {
-        auto it = users.find(userId);
-        return (it != users.end()) ? it->second : nullptr;
+    double movedMs = elapsedMs(start);
+
+    vector<Split> buffer;
+    start = chrono::steady_clock::now();
+    for (int e = 0; e < expenseCount; e++) {
+        strategy->calculateSplit(Money(1000 + e % 5000), users, {}, buffer);
+        checksum += buffer.back().amount.paise;
     }
-    
-    // Group management
-    Group* createGroup(const string name) {
-        Group* group = new Group(name);
-        groups[group->groupId] = group;
-        cout << "Group created: " << name << " (ID: " << group->groupId << ")" << endl;
-        return group;
+    double reusedMs = elapsedMs(start);
+
+    cout << expenseCount << " expenses x " << splitsPerExpense << " equal splits (checksum " << checksum << ")" << endl;
+    cout << "  string splits, copied : " << fixed << setprecision(1) << legacyMs << " ms" << endl;
+    cout << "  index splits, moved   : " << movedMs << " ms" << endl;
+    cout << "  index splits, reused  : " << reusedMs << " ms" << endl;
+}
+
+// Statement queries over a year of splits: walking string-keyed Expense objects
+// (the old layout) vs the columnar history
+void benchmarkStatements() {
+    const int userCount = 10000;
+    const int expenseCount = 250000;
+    const int splitsPerExpense = 8;
+    const int64_t yearStart = 1704067200; // 2024-01-01
+    const int64_t month = 30 * 86400;
+
+    struct LegacySplit {
+        string userId;
+        Money amount;
+    };
+    struct LegacyExpense {
+        string paidByUserId;
+        vector<LegacySplit> splits;
+        int64_t timestamp;
+    };
+    IdInterner& ids = IdInterner::users();
+    vector<string> userIds;
+    for (int i = 0; i < userCount; i++) {
+        userIds.push_back("stmt" + to_string(i));
+        ids.intern(userIds.back());
     }
-    
-    Group* getGroup(const string& groupId) {
-        auto it = groups.find(groupId);
-        return (it != groups.end()) ? it->second : nullptr;
+    mt19937 rng(11);
+    map<string, LegacyExpense*> legacy;
+    ExpenseColumns columns;
+    for (int e = 0; e < expenseCount; e++) {
+        LegacyExpense* expense = new LegacyExpense{userIds[rng() % userCount], {}, yearStart + (int64_t)(rng() % (12 * month))};
+        for (int s = 0; s < splitsPerExpense; s++) {
+            expense->splits.push_back({userIds[rng() % userCount], Money(100 + rng() % 10000)});
+            columns.append(ids.find(expense->paidByUserId), ids.find(expense->splits.back().userId), 1,
+                           expense->timestamp, expense->splits.back().amount);
+        }
+        legacy["expense" + to_string(e)] = expense;
     }
-    
-    void addUserToGroup(const string& userId, const string& groupId) {
-        User* user = getUser(userId);
-        Group* group = getGroup(groupId);
-        
-        if (user && group) {
-            group->addMember(user);
+    const string& target = userIds[42];
+    UserIndex targetIndex = ids.find(target);
+
+    // Totals owed / owing for one user
+    auto start = chrono::steady_clock::now();
+    Money legacyOwes, legacyOwed;
+    for (auto& entry : legacy) {
+        for (const LegacySplit& split : entry.second->splits) {
+            if (split.userId == entry.second->paidByUserId) continue;
+            if (split.userId == target) legacyOwes += split.amount;
+            if (entry.second->paidByUserId == target) legacyOwed += split.amount;
         }
     }
-    
-    // Try to remove user from group - just delegates to group
-    bool removeUserFromGroup(const string& userId, const string& groupId) {
-        Group* group = getGroup(groupId);
-        
-        if (!group) {
-            cout << "Group not found!" << endl;
-            return false;
+    double legacyTotalsMs = elapsedMs(start);
+    start = chrono::steady_clock::now();
+    Money owes, owed;
+    columns.totalsFor(targetIndex, owes, owed);
+    double totalsMs = elapsedMs(start);
+
+    // Monthly spend for one user
+    start = chrono::steady_clock::now();
+    vector<Money> legacySpend(12);
+    for (auto& entry : legacy) {
+        for (const LegacySplit& split : entry.second->splits) {
+            if (split.userId == target) {
+                legacySpend[(entry.second->timestamp - yearStart) / month] += split.amount;
+            }
         }
-        
-        User* user = getUser(userId);
-        if (!user) {
-            cout << "User not found!" << endl;
-            return false;
+    }
+    double legacySpendMs = elapsedMs(start);
+    start = chrono::steady_clock::now();
+    vector<Money> spend = columns.spendByPeriod(targetIndex, yearStart, month, 12);
+    double spendMs = elapsedMs(start);
+
+    // Top 10 payers
+    start = chrono::steady_clock::now();
+    unordered_map<string, Money> legacyPaid;
+    for (auto& entry : legacy) {
+        for (const LegacySplit& split : entry.second->splits) {
+            legacyPaid[entry.second->paidByUserId] += split.amount;
         }
+    }
+    vector<pair<Money, string>> legacyTop;
+    for (auto& paid : legacyPaid) legacyTop.push_back({paid.second, paid.first});
+    partial_sort(legacyTop.begin(), legacyTop.begin() + 10, legacyTop.end(), greater<pair<Money, string>>());
+    double legacyTopMs = elapsedMs(start);
+    start = chrono::steady_clock::now();
+    vector<pair<UserIndex, Money>> top = columns.topPayers(10);
+    double topMs = elapsedMs(start);
 
-        bool userRemoved = group->removeMember(userId);
-        
-        if(userRemoved) {
-            cout << user->name << " successfully left " << group->name << endl;
+    bool same = legacyOwes == owes && legacyOwed == owed && legacySpend == spend &&
+                legacyTop[0].first == top[0].second;
+    cout << expenseCount * splitsPerExpense << " splits, " << userCount << " users"
+         << (same ? "" : " (RESULTS DIFFER)") << endl;
+    cout << "                 objects    columns" << endl;
+    cout << fixed << setprecision(2);
+    cout << "  totals      " << setw(8) << legacyTotalsMs << " ms" << setw(8) << totalsMs << " ms" << endl;
+    cout << "  monthly     " << setw(8) << legacySpendMs << " ms" << setw(8) << spendMs << " ms" << endl;
+    cout << "  top payers  " << setw(8) << legacyTopMs << " ms" << setw(8) << topMs << " ms" << endl;
+
+    for (auto& entry : legacy) {
+        delete entry.second;
+    }
+}
+
+// 50 balance reads per write on a 1000 member group: a mutex-guarded table whose
+// reads copy the member's row into a map vs published snapshots read in place
+void benchmarkSnapshotReads() {
+    const int memberCount = 1000;
+    const int initialBalances = 40000;
+    const int operations = 102000;
+    const int readsPerWrite = 50;
+
+    DiscardBuffer discard;
+    streambuf* console = cout.rdbuf(&discard);
+    Group group("Snapshots");
+    vector<unique_ptr<User>> readers;
+    vector<UserIndex> users;
+    for (int i = 0; i < memberCount; i++) {
+        readers.emplace_back(new User("Reader" + to_string(i), "reader@example.com"));
+        group.addMember(readers.back().get());
+        users.push_back(readers.back()->index);
+    }
+    cout.rdbuf(console);
+
+    BalanceTable table;
+    mutex tableMutex;
+    for (UserIndex user : users) {
+        table.addRow(user);
+    }
+    mt19937 rng(5);
+    for (int i = 0; i < initialBalances; i++) {
+        UserIndex a = users[rng() % memberCount], b = users[rng() % memberCount];
+        Money amount(100 + rng() % 10000);
+        if (a == b) continue;
+        table.add(a, b, amount);
+        group.updateGroupBalance(a, b, amount);
+    }
+
+    const IdInterner& ids = IdInterner::users();
+    int64_t checksum = 0;
+    rng.seed(6);
+    auto start = chrono::steady_clock::now();
+    for (int op = 0; op < operations; op++) {
+        UserIndex a = users[rng() % memberCount], b = users[rng() % memberCount];
+        lock_guard<mutex> lock(tableMutex);
+        if (op % (readsPerWrite + 1) == 0) {
+            if (a != b) table.add(a, b, Money(100));
+        } else {
+            map<string, Money> balances;
+            table.find(a)->forEach([&](uint32_t other, Money amount) {
+                balances[ids.idOf(other)] = amount;
+            });
+            checksum += balances.size();
         }
-        return userRemoved;
     }
-    
-    // Expense management - delegate to group
-    void addExpenseToGroup(string& groupId, string description, double amount, 
-                          string& paidByUserId, vector<string>& involvedUsers, 
-                          SplitType splitType, const vector<double>& splitValues = {}) {
-        
-        Group* group = getGroup(groupId);
-        if (!group) {
-            cout << "Group not found!" << endl;
-            return;
+    double lockedMs = elapsedMs(start);
+
+    rng.seed(6);
+    start = chrono::steady_clock::now();
+    for (int op = 0; op < operations; op++) {
+        UserIndex a = users[rng() % memberCount], b = users[rng() % memberCount];
+        if (op % (readsPerWrite + 1) == 0) {
+            lock_guard<mutex> lock(group.groupMutex);
+            if (a != b) group.updateGroupBalance(a, b, Money(100));
+        } else {
+            Group::BalanceReader snapshot = group.readBalances();
+            checksum -= snapshot->rowOf(a)->entries.size();
         }
-        
-        group->addExpense(description, amount, paidByUserId, involvedUsers, splitType, splitValues);
     }
-    
-    // Settlement - delegate to group
-    void settlePaymentInGroup(string& groupId, string& fromUserId, 
-                              string& toUserId, double amount) {
-        
-        Group* group = getGroup(groupId);
-        if (!group) {
-            cout << "Group not found!" << endl;
-            return;
+    double snapshotMs = elapsedMs(start);
+
+    cout << memberCount << " members, " << operations << " operations, " << readsPerWrite
+         << " reads per write" << (checksum == 0 ? "" : " (RESULTS DIFFER)") << endl;
+    cout << "  locked table, copied rows : " << fixed << setprecision(1) << lockedMs << " ms" << endl;
+    cout << "  published snapshots       : " << snapshotMs << " ms" << endl;
+}
+
+// Nightly settlement of many small circles of friends, each sharing a few groups plus
+// individual debts: per-group plans (plus one payment per individual balance) vs one
+// global plan over connected components, on 1..N threads
+void benchmarkGlobalSettlement() {
+    const int circleCount = 30000;
+    const int circleSize = 8;
+    const int groupsPerCircle = 3;
+    const int groupSize = 4;
+    const int expensesPerGroup = 6;
+    const int individualDebts = 2;
+
+    mt19937 rng(13);
+    size_t userCount = circleCount * circleSize;
+    vector<vector<UserIndex>> groupUsers;
+    vector<vector<Money>> groupNets;
+    vector<tuple<UserIndex, UserIndex, Money>> balances; // one side of every balance
+    for (int c = 0; c < circleCount; c++) {
+        UserIndex first = c * circleSize;
+        for (int g = 0; g < groupsPerCircle; g++) {
+            vector<UserIndex> members;
+            while (members.size() < groupSize) {
+                UserIndex user = first + rng() % circleSize;
+                if (find(members.begin(), members.end(), user) == members.end()) members.push_back(user);
+            }
+            vector<Money> nets(groupSize);
+            for (int e = 0; e < expensesPerGroup; e++) {
+                int payer = rng() % groupSize, debtor = rng() % groupSize;
+                Money amount(100 + rng() % 100000);
+                if (payer == debtor) continue;
+                nets[payer] += amount;
+                nets[debtor] -= amount;
+                balances.push_back({members[payer], members[debtor], amount});
+                balances.push_back({members[debtor], members[payer], -amount});
+            }
+            groupUsers.push_back(members);
+            groupNets.push_back(nets);
+        }
+        for (int d = 0; d < individualDebts; d++) {
+            UserIndex a = first + rng() % circleSize, b = first + rng() % circleSize;
+            Money amount(100 + rng() % 50000);
+            if (a == b) continue;
+            balances.push_back({a, b, amount});
+            balances.push_back({b, a, -amount});
         }
-        
-        group->settlePayment(fromUserId, toUserId, amount);
     }
-    
-    // Settlement
-    void settleIndividualPayment(string& fromUserId, string& toUserId, double amount) {
-        User* fromUser = getUser(fromUserId);
-        User* toUser = getUser(toUserId);
-        
-        if (fromUser && toUser) {
-            fromUser->updateBalance(toUserId, amount);
-            toUser->updateBalance(fromUserId, -amount);
-            
-            cout << fromUser->name << " settled Rs" << amount << " with " << toUser->name << endl;
+
+    auto start = chrono::steady_clock::now();
+    size_t perGroupTransfers = 0;
+    for (size_t g = 0; g < groupUsers.size(); g++) {
+        perGroupTransfers += DebtSimplifier::planTransfers(groupUsers[g], groupNets[g]).size();
+    }
+    perGroupTransfers += circleCount * individualDebts; // individual balances are paid one by one
+    double perGroupMs = elapsedMs(start);
+
+    // Applying a plan must zero every net position
+    auto settles = [&](const vector<Transfer>& plan) {
+        vector<int64_t> nets(userCount);
+        for (auto& balance : balances) nets[get<0>(balance)] += get<2>(balance).paise;
+        for (const Transfer& transfer : plan) {
+            nets[transfer.from] += transfer.amount.paise;
+            nets[transfer.to] -= transfer.amount.paise;
+        }
+        return all_of(nets.begin(), nets.end(), [](int64_t net) { return net == 0; });
+    };
+
+    cout << circleCount << " circles of " << circleSize << " users, " << groupUsers.size() << " groups, "
+         << balances.size() / 2 << " debts" << endl;
+    cout << "  per group     : " << setw(7) << perGroupTransfers << " transfers, " << fixed << setprecision(1)
+         << perGroupMs << " ms" << endl;
+    unsigned hardwareThreads = max(1u, thread::hardware_concurrency());
+    for (unsigned threads = 1; threads <= max(4u, hardwareThreads); threads *= 2) {
+        start = chrono::steady_clock::now();
+        GlobalSettlementPlanner planner(userCount);
+        for (auto& balance : balances) {
+            planner.addBalance(get<0>(balance), get<1>(balance), get<2>(balance));
         }
+        vector<Transfer> plan = planner.plan(SimplifyMode::AUTO, threads);
+        double ms = elapsedMs(start);
+        cout << "  global, " << threads << " thr : " << setw(7) << plan.size() << " transfers, " << ms << " ms"
+             << (settles(plan) ? "" : " (DOES NOT SETTLE)") << endl;
     }
-    
-    void addIndividualExpense(string description, double amount, string paidByUserId,
-                             string toUserId, SplitType splitType,
-                            const vector<double>& splitValues = {}) {
+}
 
-        SplitStrategy* strategy = SplitFactory::getSplitStrategy(splitType);
-        vector<Split> splits = strategy->calculateSplit(amount, {paidByUserId, toUserId}, splitValues);
+// Mixed requests (70% balance reads, 25% expenses, 5% settlements) spread over many
+// groups from 1..N threads: one global lock around every request vs the sharded facade
+void benchmarkConcurrentRequests() {
+    const int groupCount = 64;
+    const int membersPerGroup = 20;
+    const int requestsPerThread = 20000;
 
-        Expense* expense = new Expense(description, amount, paidByUserId, splits);
-        expenses[expense->expenseId] = expense;
-        
-        User* paidByUser = getUser(paidByUserId);
-        User* toUser = getUser(toUserId);
+    Splitwise* manager = Splitwise::getInstance();
+    DiscardBuffer discard;
+    streambuf* console = cout.rdbuf(&discard);
 
-        paidByUser->updateBalance(toUserId, amount);
-        toUser->updateBalance(paidByUserId, -amount);
-        
-        cout << "Individual expense added: " << description << " (Rs " << amount 
-                << ") paid by " << paidByUser->name <<" for " << toUser->name << endl;
+    vector<string> groupIds;
+    vector<vector<string>> memberIds(groupCount);
+    for (int g = 0; g < groupCount; g++) {
+        groupIds.push_back(manager->createGroup("Load" + to_string(g))->groupId);
+        for (int i = 0; i < membersPerGroup; i++) {
+            memberIds[g].push_back(manager->createUser("Member" + to_string(i), "load@example.com")->userId);
+            manager->addUserToGroup(memberIds[g].back(), groupIds[g]);
+        }
     }
-    
-    // Display Method
-    void showUserBalance(string& userId) {
-        User* user = getUser(userId);
-        if (!user) return;
-        
-        cout << endl << "=========== Balance for " << user->name <<" ===================="<<endl; 
-        cout << "Total you owe: Rs " << fixed << setprecision(2) << user->getTotalOwed() << endl;
-        cout << "Total others owe you: Rs " << fixed << setprecision(2) << user->getTotalOwing() << endl;
-        
-        cout << "Detailed balances:" << endl;
-        for (auto& balance : user->balances) {
-            User* otherUser = getUser(balance.first);
-            if (otherUser) {
-                if (balance.second > 0) {
-                    cout << "  " << otherUser->name << " owes you: Rs" << balance.second << endl;
+
+    mutex globalLock;
+    auto requestsPerSecond = [&](int threadCount, bool global) {
+        auto worker = [&](int seed) {
+            mt19937 rng(seed);
+            for (int r = 0; r < requestsPerThread; r++) {
+                int g = rng() % groupCount;
+                int a = rng() % membersPerGroup;
+                int b = (a + 1 + rng() % (membersPerGroup - 1)) % membersPerGroup;
+                int kind = rng() % 100;
+
+                unique_lock<mutex> lock(globalLock, defer_lock);
+                if (global) lock.lock();
+                if (kind < 70) {
+                    manager->getUserGroupBalances(groupIds[g], memberIds[g][a]);
+                } else if (kind < 95) {
+                    vector<string> involved = {memberIds[g][a], memberIds[g][b]};
+                    manager->addExpenseToGroup(groupIds[g], "Load", Money(100 + rng() % 10000),
+                                               memberIds[g][a], involved, SplitType::EQUAL);
                 } else {
-                    cout << "  You owe " << otherUser->name << ": Rs" << abs(balance.second) << endl;
+                    manager->settlePaymentInGroup(groupIds[g], memberIds[g][a], memberIds[g][b], Money(100));
                 }
             }
+        };
+        auto start = chrono::steady_clock::now();
+        vector<thread> threads;
+        for (int t = 0; t < threadCount; t++) {
+            threads.emplace_back(worker, 1000 * threadCount + t);
         }
+        for (thread& t : threads) {
+            t.join();
+        }
+        return threadCount * requestsPerThread / elapsedMs(start) * 1000;
+    };
+
+    // Every run adds expenses to the same singleton, so the two modes take turns going
+    // first and each keeps its best of three runs
+    const int rounds = 3;
+    unsigned hardwareThreads = max(1u, thread::hardware_concurrency());
+    vector<pair<double, double>> results;
+    for (unsigned threads = 1; threads <= max(4u, hardwareThreads); threads *= 2) {
+        pair<double, double> best = {0, 0};
+        for (int round = 0; round < rounds; round++) {
+            bool globalFirst = round % 2 == 0;
+            double first = requestsPerSecond(threads, globalFirst);
+            double second = requestsPerSecond(threads, !globalFirst);
+            best.first = max(best.first, globalFirst ? first : second);
+            best.second = max(best.second, globalFirst ? second : first);
+        }
+        results.push_back(best);
     }
-    
-    void showGroupBalances(string& groupId) {
-        Group* group = getGroup(groupId);
-        if (!group) return;
-        
-        group->showGroupBalances();
+
+    cout.rdbuf(console);
+    cout << groupCount << " groups x " << membersPerGroup << " members, " << requestsPerThread
+         << " requests per thread, " << hardwareThreads << " hardware threads" << endl;
+    cout << "  threads   global lock      sharded (requests/s)" << endl;
+    for (size_t i = 0; i < results.size(); i++) {
+        cout << "  " << setw(7) << (1 << i) << fixed << setprecision(0) << setw(14) << results[i].first
+             << setw(13) << results[i].second << endl;
     }
-    
-    void simplifyGroupDebts(string& groupId) {
-        Group* group = getGroup(groupId);
-        if (!group) return;
-                
-        // Use group's balance data for debt simplification
-        group->simplifyGroupDebts();
+    if (hardwareThreads == 1) {
+        cout << "  one hardware thread: extra threads only time-slice, so neither column can scale here" << endl;
+    }
+}
+
+// Zipf(s) over ranks 0..n-1 by inverse CDF lookup: rank k has weight 1 / (k + 1)^s
+class ZipfGenerator {
+private:
+    vector<double> cdf;
+    uniform_real_distribution<double> uniform{0.0, 1.0};
+
+public:
+    ZipfGenerator(size_t n, double s) : cdf(n) {
+        double total = 0;
+        for (size_t k = 0; k < n; k++) {
+            total += 1.0 / pow(k + 1, s);
+            cdf[k] = total;
+        }
+        for (double& value : cdf) {
+            value /= total;
+        }
+    }
+
+    size_t operator()(mt19937& rng) {
+        size_t rank = lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin();
+        return min(rank, cdf.size() - 1);
     }
 };
 
-Splitwise* Splitwise::instance = nullptr;
+// Log-linear latency histogram (HdrHistogram style): exact below 32 ns, then 32
+// sub-buckets per power of two, so every value keeps ~3% precision in fixed memory
+class LatencyHistogram {
+private:
+    static const int SUB_BITS = 5;
+    static const uint64_t SUB_COUNT = 1 << SUB_BITS;
+    vector<uint64_t> counts = vector<uint64_t>((64 - SUB_BITS + 1) * SUB_COUNT);
+    uint64_t total = 0;
+    uint64_t maxValue = 0;
+
+    static size_t bucketOf(uint64_t ns) {
+        if (ns < SUB_COUNT) return ns;
+        int top = 63 - __builtin_clzll(ns);
+        return (top - SUB_BITS + 1) * SUB_COUNT + ((ns >> (top - SUB_BITS)) - SUB_COUNT);
+    }
+
+    // Largest value that lands in the bucket
+    static uint64_t highestOf(size_t bucket) {
+        if (bucket < SUB_COUNT) return bucket;
+        int shift = bucket / SUB_COUNT - 1;
+        uint64_t lowest = (SUB_COUNT + bucket % SUB_COUNT) << shift;
+        return lowest + (1ull << shift) - 1;
+    }
+
+public:
+    void record(uint64_t ns) {
+        counts[bucketOf(ns)]++;
+        total++;
+        maxValue = std::max(maxValue, ns);
+    }
+
+    uint64_t count() const {
+        return total;
+    }
+
+    uint64_t max() const {
+        return maxValue;
+    }
+
+    // Value at or below which `fraction` of the recorded values fall
+    uint64_t percentile(double fraction) const {
+        uint64_t rank = (uint64_t)ceil(fraction * total);
+        uint64_t seen = 0;
+        for (size_t bucket = 0; bucket < counts.size(); bucket++) {
+            seen += counts[bucket];
+            if (seen >= rank && seen > 0) return std::min(highestOf(bucket), maxValue);
+        }
+        return maxValue;
+    }
+};
+
+// Synthetic production-like load through the facade: users in groups of 4-20, group
+// traffic Zipf-skewed, requests mixed 80% expenses / 15% settlements / 4% balance pages /
+// 1% simplifications. Output is discarded, so the numbers measure the engine, not cout.
+void benchmarkLoad() {
+    const int userCount = 10000;
+    const int groupCount = 1000;
+    const int requestCount = 200000;
+    const double zipfSkew = 1.1;
+
+    // Requests still render their output (showBalances builds its report) but it goes
+    // nowhere, so the terminal is not part of the latencies
+    Splitwise* manager = Splitwise::getInstance();
+    DiscardBuffer discard;
+    ostream discarded(&discard);
+    BufferedTextSink sink(discarded, 64 * 1024);
+    EventSink* events = EventSink::install(&sink);
+    mt19937 rng(17);
+
+    vector<string> userIds;
+    for (int i = 0; i < userCount; i++) {
+        userIds.push_back(manager->createUser("Load" + to_string(i), "load@example.com")->userId);
+    }
+    vector<string> groupIds;
+    vector<vector<string>> groupMembers(groupCount);
+    for (int g = 0; g < groupCount; g++) {
+        groupIds.push_back(manager->createGroup("LoadGroup" + to_string(g))->groupId);
+        size_t size = 4 + rng() % 17;
+        while (groupMembers[g].size() < size) {
+            const string& userId = userIds[rng() % userCount];
+            if (find(groupMembers[g].begin(), groupMembers[g].end(), userId) == groupMembers[g].end()) {
+                groupMembers[g].push_back(userId);
+                manager->addUserToGroup(userId, groupIds[g]);
+            }
+        }
+    }
+    // Popularity rank -> group, so the hottest groups are not simply the oldest
+    vector<int> groupByRank(groupCount);
+    for (int g = 0; g < groupCount; g++) groupByRank[g] = g;
+    shuffle(groupByRank.begin(), groupByRank.end(), rng);
+    ZipfGenerator pickGroup(groupCount, zipfSkew);
+
+    const char* names[] = {"addExpense", "settlePayment", "showBalances", "simplify"};
+    LatencyHistogram latencies[4];
+    auto start = chrono::steady_clock::now();
+    for (int r = 0; r < requestCount; r++) {
+        int g = groupByRank[pickGroup(rng)];
+        vector<string>& members = groupMembers[g];
+        int kind = rng() % 100;
+        kind = (kind < 80) ? 0 : (kind < 95) ? 1 : (kind < 99) ? 2 : 3;
 
-int main() {
+        auto requestStart = chrono::steady_clock::now();
+        if (kind == 0) {
+            vector<string> involved = members;
+            shuffle(involved.begin(), involved.end(), rng);
+            involved.resize(2 + rng() % min<size_t>(5, members.size() - 1));
+            manager->addExpenseToGroup(groupIds[g], "Load", Money(100 + rng() % 500000), involved[0],
+                                       involved, SplitType::EQUAL);
+        } else if (kind == 1) {
+            int a = rng() % members.size();
+            int b = (a + 1 + rng() % (members.size() - 1)) % members.size();
+            manager->settlePaymentInGroup(groupIds[g], members[a], members[b], Money(100 + rng() % 50000));
+        } else if (kind == 2) {
+            manager->showGroupBalances(groupIds[g]);
+        } else {
+            manager->simplifyGroupDebts(groupIds[g]);
+        }
+        latencies[kind].record(chrono::duration_cast<chrono::nanoseconds>(
+            chrono::steady_clock::now() - requestStart).count());
+    }
+    double totalMs = elapsedMs(start);
+
+    EventSink::install(events);
+    cout << userCount << " users, " << groupCount << " groups of 4-20, " << requestCount
+         << " requests, Zipf s=" << zipfSkew << " over groups" << endl;
+    cout << "  throughput: " << fixed << setprecision(0) << requestCount / totalMs * 1000 << " requests/s" << endl;
+    cout << "  request           count     p50 us     p99 us    p999 us     max us" << endl;
+    for (int kind = 0; kind < 4; kind++) {
+        const LatencyHistogram& histogram = latencies[kind];
+        cout << "  " << left << setw(14) << names[kind] << right << setw(8) << histogram.count() << setprecision(1);
+        for (double fraction : {0.5, 0.99, 0.999}) {
+            cout << setw(11) << histogram.percentile(fraction) / 1000.0;
+        }
+        cout << setw(11) << histogram.max() / 1000.0 << endl;
+    }
+}
+
+// The same request mix through each event sink. "flush per event" is what the console
+// did before sinks existed (every line ended with endl); output goes to /dev/null so
+// only the sink's own cost is measured.
+void benchmarkEventSinks() {
+    const int groupCount = 20;
+    const int membersPerGroup = 10;
+    const int requestCount = 50000;
+
+    Splitwise* manager = Splitwise::getInstance();
+    ofstream flushed("/dev/null");
+    flushed << unitbuf;
+    ofstream buffered("/dev/null");
+    string binaryPath = "/tmp/splitwise-events-" + to_string(getpid()) + ".bin";
+
+    BufferedTextSink flushingText(flushed);
+    BufferedTextSink bufferedText(buffered, 64 * 1024);
+    BinaryEventSink binary(binaryPath);
+    NullSink null;
+    vector<pair<string, EventSink*>> sinks = {
+        {"text, flush per event", &flushingText},
+        {"text, 64 KB buffer", &bufferedText},
+        {"binary, 64 KB buffer", &binary},
+        {"null", &null},
+    };
+
+    vector<double> results;
+    for (auto& sink : sinks) {
+        manager->setEventSink(sink.second);
+        mt19937 rng(23);
+        vector<string> groupIds;
+        vector<vector<string>> memberIds(groupCount);
+        for (int g = 0; g < groupCount; g++) {
+            groupIds.push_back(manager->createGroup("Sink" + to_string(g))->groupId);
+            for (int m = 0; m < membersPerGroup; m++) {
+                memberIds[g].push_back(manager->createUser("Member" + to_string(m), "sink@example.com")->userId);
+                manager->addUserToGroup(memberIds[g].back(), groupIds[g]);
+            }
+        }
+
+        auto start = chrono::steady_clock::now();
+        for (int r = 0; r < requestCount; r++) {
+            int g = rng() % groupCount;
+            int a = rng() % membersPerGroup;
+            int b = (a + 1 + rng() % (membersPerGroup - 1)) % membersPerGroup;
+            int kind = rng() % 100;
+            if (kind < 75) {
+                vector<string> involved = {memberIds[g][a], memberIds[g][b]};
+                manager->addExpenseToGroup(groupIds[g], "Tea", Money(100 + rng() % 10000),
+                                           memberIds[g][a], involved, SplitType::EQUAL);
+            } else if (kind < 95) {
+                manager->settlePaymentInGroup(groupIds[g], memberIds[g][a], memberIds[g][b], Money(100));
+            } else {
+                manager->addIndividualExpense("Cab", Money(2500), memberIds[g][a], memberIds[g][b], SplitType::EQUAL);
+            }
+        }
+        sink.second->flush();
+        results.push_back(elapsedMs(start));
+    }
+    manager->setEventSink(nullptr);
+
+    struct stat info;
+    off_t binaryBytes = stat(binaryPath.c_str(), &info) == 0 ? info.st_size : 0;
+    uint64_t binaryEvents = binary.eventCount();
+    unlink(binaryPath.c_str());
+
+    cout << groupCount << " groups x " << membersPerGroup << " members, " << requestCount
+         << " requests (75% expenses, 20% settlements, 5% individual expenses)" << endl;
+    for (size_t i = 0; i < sinks.size(); i++) {
+        cout << "  " << left << setw(24) << sinks[i].first << right << fixed << setprecision(1)
+             << setw(8) << results[i] << " ms, " << setprecision(0) << setw(8)
+             << requestCount / results[i] * 1000 << " requests/s" << endl;
+    }
+    cout << "  binary stream: " << binaryEvents << " events, " << setprecision(1)
+         << (double)binaryBytes / max<uint64_t>(binaryEvents, 1) << " bytes per event" << endl;
+}
+
+// Regression checks for inputs the demo never exercises; "./main check"
+int runChecks() {
+    EventSink* previous = EventSink::install(new NullSink());
+    Splitwise* manager = Splitwise::getInstance();
+    string alice = manager->createUser("CheckAlice", "alice@example.com")->userId;
+    string bob = manager->createUser("CheckBob", "bob@example.com")->userId;
+    string groupId = manager->createGroup("Checks")->groupId;
+    manager->addUserToGroup(alice, groupId);
+    manager->addUserToGroup(bob, groupId);
+    int failures = 0;
+    auto check = [&](const string& name, bool passed) {
+        cout << (passed ? "PASS " : "FAIL ") << name << endl;
+        failures += !passed;
+    };
+    auto throws = [](auto action) {
+        try {
+            action();
+        } catch (const runtime_error&) {
+            return true;
+        }
+        return false;
+    };
+    auto untouched = [&] {
+        return manager->getUserGroupBalances(groupId, alice).empty() &&
+               manager->getUserGroupBalances(groupId, bob).empty();
+    };
+
+    string unknown = "user-never-created";
+    vector<string> involved = {alice, bob};
+    check("expense paid by an unknown user is rejected", throws([&] {
+        manager->addExpenseToGroup(groupId, "Ghost", Money::fromRupees(100), unknown, involved, SplitType::EQUAL);
+    }) && untouched());
+    vector<string> withUnknown = {alice, unknown};
+    check("expense involving an unknown user is rejected", throws([&] {
+        manager->addExpenseToGroup(groupId, "Ghost", Money::fromRupees(100), alice, withUnknown, SplitType::EQUAL);
+    }) && untouched());
+    vector<ExpenseRecord> batch = {{"Ghost", Money::fromRupees(100), unknown, involved, SplitType::EQUAL, {}}};
+    check("batch with an unknown payer is rejected", throws([&] {
+        manager->addExpensesToGroup(groupId, batch);
+    }) && untouched());
+    vector<string> nobody;
+    check("equal split between no users is rejected", throws([&] {
+        manager->addExpenseToGroup(groupId, "Nobody", Money::fromRupees(100), alice, nobody, SplitType::EQUAL);
+    }) && untouched());
+    vector<ExpenseRecord> partlyEmpty = {{"Lunch", Money::fromRupees(100), alice, involved, SplitType::EQUAL, {}},
+                                         {"Nobody", Money::fromRupees(100), alice, nobody, SplitType::EQUAL, {}}};
+    check("batch with an expense between no users is rejected whole", throws([&] {
+        manager->addExpensesToGroup(groupId, partlyEmpty);
+    }) && untouched());
+
+    delete EventSink::install(previous);
+    cout << (failures ? to_string(failures) + " check(s) failed" : "All checks passed") << endl;
+    return failures ? 1 : 0;
+}
+
+void runBenchmarks(const string& only) {
+    vector<pair<string, void (*)()>> benchmarks = {
+        {"ingest", benchmarkExpenseIngest},
+        {"batch", benchmarkBatchImport},
+        {"notify", benchmarkAsyncNotifications},
+        {"simplify", benchmarkDebtSimplification},
+        {"pageview", benchmarkSettlementPageViews},
+        {"render", benchmarkRenderBalances},
+        {"ledger", benchmarkLedger},
+        {"concurrency", benchmarkConcurrentRequests},
+        {"split", benchmarkSplitComputation},
+        {"statements", benchmarkStatements},
+        {"snapshots", benchmarkSnapshotReads},
+        {"global", benchmarkGlobalSettlement},
+        {"load", benchmarkLoad},
+        {"sinks", benchmarkEventSinks},
+    };
+    for (auto& benchmark : benchmarks) {
+        if (only.empty() || only == benchmark.first) {
+            cout << "\n=== Benchmark: " << benchmark.first << " ===" << endl;
+            benchmark.second();
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    // "./main bench [name]" runs the benchmarks instead of the demo scenario
+    if (argc > 1 && string(argv[1]) == "bench") {
+        runBenchmarks(argc > 2 ? argv[2] : "");
+        return 0;
+    }
+    // "./main check" runs the regression checks
+    if (argc > 1 && string(argv[1]) == "check") {
+        return runChecks();
+    }
+    // One phase of "./main bench ledger" in a fresh process
+    if (argc > 2 && string(argv[1]) == "ledger-phase") {
+        return runLedgerPhase(argv[2]);
+    }
     
+
     Splitwise* manager = Splitwise::getInstance();
     
     cout << endl << "=========== Creating Users ===================="<<endl;
@@ -698,11 +4726,11 @@ int main() {
 
     cout << endl << "=========== Adding Expenses in group ===================="<<endl;    
     vector<string> groupMembers = {user1->userId, user2->userId, user3->userId, user4->userId};
-    manager->addExpenseToGroup(hostelGroup->groupId, "Lunch", 800.0, user1->userId, groupMembers, SplitType::EQUAL);
+    manager->addExpenseToGroup(hostelGroup->groupId, "Lunch", Money::fromRupees(800), user1->userId, groupMembers, SplitType::EQUAL);
     
     vector<string> dinnerMembers = {user1->userId, user3->userId, user4->userId};
     vector<double> dinnerAmounts = {200.0, 300.0, 200.0};
-    manager->addExpenseToGroup(hostelGroup->groupId, "Dinner", 700.0, user3->userId, dinnerMembers, 
+    manager->addExpenseToGroup(hostelGroup->groupId, "Dinner", Money::fromRupees(700), user3->userId, dinnerMembers, 
                              SplitType::EXACT, dinnerAmounts);
 
     cout << endl << "=========== printing Group-Specific Balances ===================="<<endl; 
@@ -715,7 +4743,7 @@ int main() {
     manager->showGroupBalances(hostelGroup->groupId);
 
     cout << endl << "=========== Adding Individual Expense ===================="<<endl; 
-    manager->addIndividualExpense("Coffee", 40.0, user2->userId, user4->userId, SplitType::EQUAL);
+    manager->addIndividualExpense("Coffee", Money::fromRupees(40), user2->userId, user4->userId, SplitType::EQUAL);
     
     cout << endl << "=========== printing User Balances ===================="<<endl; 
     manager->showUserBalance(user1->userId);
@@ -727,7 +4755,7 @@ int main() {
     manager->removeUserFromGroup(user2->userId, hostelGroup->groupId);
 
     cout << endl << "======== Making Settlement to Clear Rohit's Debt =========="<<endl; 
-    manager->settlePaymentInGroup(hostelGroup->groupId, user2->userId, user3->userId, 200.0);
+    manager->settlePaymentInGroup(hostelGroup->groupId, user2->userId, user3->userId, Money::fromRupees(200));
     
     cout << endl << "======== Attempting to Remove Rohit Again =========="<<endl;
     manager->removeUserFromGroup(user2->userId, hostelGroup->groupId);
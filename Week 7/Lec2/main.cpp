@@ -1,5 +1,20 @@
 #include <iostream>
 #include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <random>
+#include <chrono>
+#include <cstdint>
+#include <sstream>
+#include <iomanip>
+#include <utility>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <fstream>
+#include <algorithm>
 
 using namespace std;
 
@@ -12,67 +27,438 @@ class HasCoinState;
 class DispenseState;
 class SoldOutState;
 
+enum class VendingStateId : uint8_t {
+    NO_COIN,
+    HAS_COIN,
+    DISPENSING,
+    SOLD_OUT
+};
+
+string vendingStateName(VendingStateId state) {
+    switch (state) {
+        case VendingStateId::NO_COIN: return "NO_COIN";
+        case VendingStateId::HAS_COIN: return "HAS_COIN";
+        case VendingStateId::DISPENSING: return "DISPENSING";
+        case VendingStateId::SOLD_OUT: return "SOLD_OUT";
+    }
+    return "UNKNOWN";
+}
+
 // Abstract State Interface
+// States hold no data of their own, so one instance of each is shared by every machine
 class VendingState {
 public:
     virtual VendingState* insertCoin(VendingMachine* machine, int coin) = 0;
-    virtual VendingState* selectItem(VendingMachine* machine) = 0;
+    virtual VendingState* selectItem(VendingMachine* machine, int slot) = 0;
     virtual VendingState* dispense(VendingMachine* machine) = 0;
     virtual VendingState* returnCoin(VendingMachine* machine) = 0;
-    virtual VendingState* refill(VendingMachine* machine, int quantity) = 0;
+    virtual VendingState* refill(VendingMachine* machine, int slot, int quantity) = 0;
     virtual string getStateName() = 0;
+    virtual VendingStateId getStateId() = 0;
+};
+
+// Prices per slot, shared by every machine stocked the same way (flyweight).
+// Lists are interned, so machines only hold a pointer and equal lists are stored once.
+class PriceList {
+private:
+    vector<int> prices;
+
+    explicit PriceList(const vector<int>& prices) : prices(prices) {}
+
+public:
+    static const int MAX_SLOTS = 64;
+
+    static const PriceList* of(const vector<int>& prices) {
+        if (prices.empty() || prices.size() > MAX_SLOTS) {
+            throw runtime_error("a machine has 1 to " + to_string(MAX_SLOTS) + " slots");
+        }
+        static mutex internMutex;
+        static map<vector<int>, unique_ptr<PriceList>> interned;
+        lock_guard<mutex> lock(internMutex);
+        unique_ptr<PriceList>& list = interned[prices];
+        if (!list) {
+            list.reset(new PriceList(prices));
+        }
+        return list.get();
+    }
+
+    int slotCount() const {
+        return prices.size();
+    }
+
+    int priceOf(int slot) const {
+        return prices[slot];
+    }
+};
+
+// Denominations a machine accepts and pays out, largest first. Whether greedy change is
+// always optimal (a canonical system) is decided once per system; systems are interned
+// and shared like price lists.
+class CoinSystem {
+private:
+    vector<int> denominations;
+    bool canonical;
+
+    explicit CoinSystem(const vector<int>& values) : denominations(values) {
+        sort(denominations.rbegin(), denominations.rend());
+        canonical = greedyIsOptimal();
+    }
+
+    // A counterexample, if any, is below the sum of the two largest coins (Kozen & Zaks),
+    // so comparing greedy with an unlimited-coin DP up to there settles it
+    bool greedyIsOptimal() const {
+        if (denominations.size() < 3) return true;
+        int limit = denominations[0] + denominations[1];
+        vector<int> fewest(limit + 1, INT32_MAX);
+        fewest[0] = 0;
+        for (int amount = 1; amount <= limit; amount++) {
+            for (int value : denominations) {
+                if (value <= amount && fewest[amount - value] != INT32_MAX) {
+                    fewest[amount] = min(fewest[amount], fewest[amount - value] + 1);
+                }
+            }
+            int left = amount, greedy = 0;
+            for (int value : denominations) {
+                greedy += left / value;
+                left %= value;
+            }
+            int greedyCoins = left == 0 ? greedy : INT32_MAX;
+            if (greedyCoins != fewest[amount]) return false;
+        }
+        return true;
+    }
+
+public:
+    static const CoinSystem* of(const vector<int>& values) {
+        if (values.empty() || *min_element(values.begin(), values.end()) <= 0) {
+            throw runtime_error("coin values must be positive");
+        }
+        static mutex internMutex;
+        static map<vector<int>, unique_ptr<CoinSystem>> interned;
+        lock_guard<mutex> lock(internMutex);
+        unique_ptr<CoinSystem>& system = interned[values];
+        if (!system) {
+            system.reset(new CoinSystem(values));
+        }
+        return system.get();
+    }
+
+    int size() const {
+        return denominations.size();
+    }
+
+    int value(int index) const {
+        return denominations[index];
+    }
+
+    // -1 if the coin is not accepted
+    int indexOf(int coin) const {
+        for (int i = 0; i < size(); i++) {
+            if (denominations[i] == coin) return i;
+        }
+        return -1;
+    }
+
+    bool isCanonical() const {
+        return canonical;
+    }
+};
+
+// The coins one machine holds, and the change-making engine over them.
+// planChange() answers with the fewest coins that pay an amount exactly:
+//   - greedy, when the system is canonical and no denomination runs short (O(coins))
+//   - otherwise a bounded min-coin DP table, built lazily and reused while it is still
+//     right for the coins held, so lookups are O(coins) between rebuilds. The table
+//     only sees as many coins of a value as could fit in its limit, so once the box has
+//     filled up, coins coming and going rarely invalidate it.
+class CoinInventory {
+private:
+    const CoinSystem* system;
+    vector<int> counts;      // per denomination, in the system's order
+    uint64_t generation = 0;
+
+    // DP over the counts split into binary pieces (1, 2, 4... coins of a value), which
+    // turns the bounded problem into 0/1 items. took[item * width + amount] records
+    // whether the item improved `amount` when it was processed.
+    struct Piece {
+        int denomination;
+        int coins;
+    };
+    uint64_t tableGeneration = UINT64_MAX; // counts last checked against the table
+    int tableLimit = -1;
+    vector<int> tableCounts; // coins per denomination the table was built from
+    vector<Piece> pieces;
+    vector<int> fewest;
+    vector<uint8_t> took;
+
+    uint64_t fastPathHits = 0;
+    uint64_t tableLookups = 0;
+    uint64_t tableBuilds = 0;
+
+    // Coins of denomination i that can matter for amounts up to `limit`
+    int usable(int i, int limit) const {
+        return min(counts[i], limit / system->value(i));
+    }
+
+    // The counts may have changed since the table was built without changing what it sees
+    bool tableIsCurrent() {
+        if (tableGeneration == generation) return true;
+        for (int i = 0; i < system->size(); i++) {
+            if (usable(i, tableLimit) != tableCounts[i]) return false;
+        }
+        tableGeneration = generation;
+        return true;
+    }
+
+    void buildTable(int limit) {
+        pieces.clear();
+        tableCounts.resize(system->size());
+        for (int i = 0; i < system->size(); i++) {
+            tableCounts[i] = usable(i, limit);
+            for (int left = tableCounts[i], size = 1; left > 0; size <<= 1) {
+                int coins = min(size, left);
+                pieces.push_back({i, coins});
+                left -= coins;
+            }
+        }
+        int width = limit + 1;
+        fewest.assign(width, INT32_MAX);
+        fewest[0] = 0;
+        took.assign(pieces.size() * width, 0);
+        for (size_t item = 0; item < pieces.size(); item++) {
+            int value = system->value(pieces[item].denomination) * pieces[item].coins;
+            for (int amount = limit; amount >= value; amount--) {
+                int before = fewest[amount - value];
+                if (before != INT32_MAX && before + pieces[item].coins < fewest[amount]) {
+                    fewest[amount] = before + pieces[item].coins;
+                    took[item * width + amount] = 1;
+                }
+            }
+        }
+        tableGeneration = generation;
+        tableLimit = limit;
+        tableBuilds++;
+    }
+
+public:
+    CoinInventory(const CoinSystem* system, const vector<int>& counts) : system(system), counts(counts) {
+        this->counts.resize(system->size(), 0);
+    }
+
+    // Takes an inserted coin into the box; false if the denomination is not accepted
+    bool accept(int coin) {
+        int index = system->indexOf(coin);
+        if (index < 0) return false;
+        counts[index]++;
+        generation++;
+        return true;
+    }
+
+    void load(int coin, int count) {
+        int index = system->indexOf(coin);
+        if (index < 0 || count <= 0) return;
+        counts[index] += count;
+        generation++;
+    }
+
+    // Fewest coins (count per denomination) that pay `amount` exactly from the coins
+    // held; false if no combination does. Nothing is removed, see pay().
+    bool planChange(int amount, vector<int>& out) {
+        out.assign(system->size(), 0);
+        if (amount <= 0) return amount == 0;
+
+        if (system->isCanonical()) {
+            int left = amount;
+            bool shortOfCoins = false;
+            for (int i = 0; i < system->size() && left > 0; i++) {
+                int wanted = left / system->value(i);
+                out[i] = min(wanted, counts[i]);
+                shortOfCoins |= out[i] < wanted;
+                left -= out[i] * system->value(i);
+            }
+            if (left == 0 && !shortOfCoins) {
+                fastPathHits++;
+                return true;
+            }
+            out.assign(system->size(), 0);
+        }
+
+        tableLookups++;
+        if (amount > tableLimit) {
+            buildTable(max(amount, 2 * tableLimit));
+        } else if (!tableIsCurrent()) {
+            buildTable(tableLimit);
+        }
+        if (fewest[amount] == INT32_MAX) return false;
+        int width = tableLimit + 1;
+        for (size_t item = pieces.size(); item-- > 0 && amount > 0; ) {
+            if (took[item * width + amount]) {
+                out[pieces[item].denomination] += pieces[item].coins;
+                amount -= system->value(pieces[item].denomination) * pieces[item].coins;
+            }
+        }
+        return true;
+    }
+
+    // Cash collection: the operator empties the box down to `keep` coins per denomination
+    void collect(int keep) {
+        for (int& count : counts) {
+            count = min(count, keep);
+        }
+        generation++;
+    }
+
+    void pay(const vector<int>& coins) {
+        for (int i = 0; i < system->size(); i++) {
+            counts[i] -= coins[i];
+        }
+        generation++;
+    }
+
+    // "10 + 5 + 5"
+    string describe(const vector<int>& coins) const {
+        string text;
+        for (int i = 0; i < system->size(); i++) {
+            for (int k = 0; k < coins[i]; k++) {
+                text += (text.empty() ? "" : " + ") + to_string(system->value(i));
+            }
+        }
+        return text;
+    }
+
+    int countOf(int coin) const {
+        int index = system->indexOf(coin);
+        return index < 0 ? 0 : counts[index];
+    }
+
+    const CoinSystem* getSystem() const {
+        return system;
+    }
+
+    uint64_t getFastPathHits() const { return fastPathHits; }
+    uint64_t getTableLookups() const { return tableLookups; }
+    uint64_t getTableBuilds() const { return tableBuilds; }
 };
 
 // Context Class - Vending Machine
+// Inventory is kept as parallel arrays: item counts per slot here, prices per slot in
+// the shared PriceList. A bit per slot tracks which slots are sold out.
 class VendingMachine {
 private:
     VendingState* currentState;
-    int itemCount;
-    int itemPrice;
-    int  insertedCoins;
-    
-    // State objects (we'll initialize these)
-    VendingState* noCoinState;
-    VendingState* hasCoinState;
-    VendingState* dispenseState;
-    VendingState* soldOutState;
+    const PriceList* prices;
+    unique_ptr<int32_t[]> slotCounts; // one per price list slot
+    uint64_t soldOutSlots;   // bit i set = slot i is empty
+    int insertedCoins;
+    uint8_t selectedSlot;    // paid for, waiting to be dispensed
+    ostream* output;         // where the states print, cout by default
+    unique_ptr<CoinInventory> coinBox; // nullptr = change from an unlimited float
     
 public:
+    // Every slot starts with `itemsPerSlot` items
+    VendingMachine(const PriceList* prices, int itemsPerSlot = 0);
+
+    // Single product machine (one slot)
     VendingMachine(int itemCount, int itemPrice);
     
     // Delegate to current state and update state based on return value
     void insertCoin(int coin);
-    void selectItem();
+    void selectItem(int slot = 0);
     void dispense();
     void returnCoin();
     void refill(int quantity);
+    void refill(int slot, int quantity);
         
     // Print the status of Vending Machine
     void printStatus();
-    
-    // Getters for states
-    VendingState* getNoCoinState() { 
-        return noCoinState;
+
+    // Messages go to `output` instead of cout. A stream without a buffer
+    // (ostream(nullptr)) makes the machine quiet: nothing is formatted.
+    void setOutput(ostream* output) {
+        this->output = output;
+    }
+    ostream& out() {
+        return *output;
+    }
+
+    VendingStateId getStateId() {
+        return currentState->getStateId();
     }
-    VendingState* getHasCoinState() { 
-        return hasCoinState;
+
+    // Give the machine a coin box: inserted coins go into it and change is paid from it,
+    // so a sale is refused when the exact change cannot be made
+    void setCoinBox(const CoinSystem* system, const vector<int>& counts) {
+        coinBox.reset(new CoinInventory(system, counts));
+    }
+    CoinInventory* getCoinBox() {
+        return coinBox.get();
     }
-    VendingState* getDispenseState() { 
-        return dispenseState; 
+    // False if the coin box does not take this coin
+    bool takeCoin(int coin) {
+        return !coinBox || coinBox->accept(coin);
     }
-    VendingState* getSoldOutState() { 
-        return soldOutState;
+    // Pays `amount` out of the coin box; `coins` describes what was paid ("" without a box)
+    bool giveChange(int amount, string& coins) {
+        coins.clear();
+        if (!coinBox) return true;
+        vector<int> plan;
+        if (!coinBox->planChange(amount, plan)) return false;
+        coinBox->pay(plan);
+        coins = coinBox->describe(plan);
+        return true;
     }
     
+    // Getters for the shared states
+    static VendingState* getNoCoinState();
+    static VendingState* getHasCoinState();
+    static VendingState* getDispenseState();
+    static VendingState* getSoldOutState();
+    
     // Data access methods
-    int getItemCount() { 
-        return itemCount; 
+    int getSlotCount() {
+        return prices->slotCount();
+    }
+    bool isValidSlot(int slot) {
+        return slot >= 0 && slot < getSlotCount();
+    }
+    int getItemCount(int slot) {
+        return slotCounts[slot];
+    }
+    int getItemCount() {
+        int total = 0;
+        for (int slot = 0; slot < getSlotCount(); slot++) {
+            total += slotCounts[slot];
+        }
+        return total;
     }
-    void decrementItemCount() { 
-        itemCount--; 
+    bool isSlotSoldOut(int slot) {
+        return (soldOutSlots >> slot) & 1;
     }
-    void incrementItemCount(int count = 1) {
-        itemCount += count;
+    bool isSoldOut() {
+        return soldOutSlots == allSlots();
+    }
+    uint64_t getSoldOutSlots() {
+        return soldOutSlots;
+    }
+    uint64_t allSlots() {
+        return getSlotCount() == 64 ? ~0ull : (1ull << getSlotCount()) - 1;
+    }
+    // Takes the paid item out of its slot
+    void removeSelectedItem() { 
+        if (--slotCounts[selectedSlot] == 0) {
+            soldOutSlots |= 1ull << selectedSlot;
+        }
+    }
+    // False if the slot does not exist, the count is negative or the total would overflow
+    bool restock(int slot, int count) {
+        if (!isValidSlot(slot) || count < 0 || slotCounts[slot] > INT32_MAX - count) {
+            return false;
+        }
+        slotCounts[slot] += count;
+        if (slotCounts[slot] > 0) {
+            soldOutSlots &= ~(1ull << slot);
+        }
+        return true;
     }
     int getInsertedCoin() { 
         return insertedCoins;
@@ -83,11 +469,18 @@ public:
     void addCoin(int coin) { 
         insertedCoins += coin;
     }
-    int getPrice() {
-        return this->itemPrice;
+    int getPrice(int slot = 0) {
+        return prices->priceOf(slot);
+    }
+    int getSelectedSlot() {
+        return selectedSlot;
+    }
+    void setSelectedSlot(int slot) {
+        selectedSlot = slot;
     }
-    void setPrice(int itemPrice) {
-        this->itemPrice = itemPrice;
+    // Bytes this machine owns (its slot counts are the only per-machine allocation)
+    size_t footprint() {
+        return sizeof(*this) + getSlotCount() * sizeof(int32_t);
     }
 };
 
@@ -95,188 +488,266 @@ public:
 class NoCoinState : public VendingState {
 public:
     VendingState* insertCoin(VendingMachine* machine, int coin) override {
+        if (!machine->takeCoin(coin)) {
+            machine->out() << "Coin not accepted. Coin returned: Rs " << coin <<endl;
+            return machine->getNoCoinState(); // Stay in same state
+        }
         machine->setInsertedCoin(coin); // Rs 10
-        cout << "Coin inserted. Current balance: Rs " << coin <<endl;
+        machine->out() << "Coin inserted. Current balance: Rs " << coin <<endl;
         return machine->getHasCoinState(); // Transition to HasCoinState
     }
     
-    VendingState* selectItem(VendingMachine* machine) override {
-       cout << "Please insert coin first!" <<endl;
+    VendingState* selectItem(VendingMachine* machine, int) override {
+       machine->out() << "Please insert coin first!" <<endl;
         return machine->getNoCoinState(); // Stay in same state
     }
     
     VendingState* dispense(VendingMachine* machine) override {
-       cout << "Please insert coin and select item first!" <<endl;
+       machine->out() << "Please insert coin and select item first!" <<endl;
         return machine->getNoCoinState(); // Stay in same state
     }
     
     VendingState* returnCoin(VendingMachine* machine) override {
-       cout << "No coin to return!" <<endl;
+       machine->out() << "No coin to return!" <<endl;
         return machine->getNoCoinState(); // Stay in same state
     }
 
-    VendingState* refill(VendingMachine* machine, int quantity) override {
-        cout << "Items refilling" <<endl;
-        machine->incrementItemCount(quantity);
+    VendingState* refill(VendingMachine* machine, int slot, int quantity) override {
+        if (!machine->restock(slot, quantity)) {
+            machine->out() << "Slot " << slot << " cannot take " << quantity << " more items" <<endl;
+            return machine->getNoCoinState(); // Stay in same state
+        }
+        machine->out() << "Items refilling" <<endl;
         return machine->getNoCoinState(); // Stay in same state
     }
     
    string getStateName() override {
         return "NO_COIN";
     }
+
+    VendingStateId getStateId() override {
+        return VendingStateId::NO_COIN;
+    }
 };
 
 // Concrete State: Coin Inserted
 class HasCoinState : public VendingState {
 public:
     VendingState* insertCoin(VendingMachine* machine, int coin) override {
+        if (!machine->takeCoin(coin)) {
+            machine->out() << "Coin not accepted. Coin returned: Rs " << coin <<endl;
+            return machine->getHasCoinState(); // Stay in same state
+        }
         machine->addCoin(coin);
-        cout << "Additional coin inserted. Current balance: Rs " << machine->getInsertedCoin() <<endl;
+        machine->out() << "Additional coin inserted. Current balance: Rs " << machine->getInsertedCoin() <<endl;
         return machine->getHasCoinState(); // Stay in same state
     }
     
-    VendingState* selectItem(VendingMachine* machine) override {
-        if (machine->getInsertedCoin() >= machine->getPrice()) {
-           cout << "Item selected. Dispensing..." <<endl;
+    VendingState* selectItem(VendingMachine* machine, int slot) override {
+        if (!machine->isValidSlot(slot)) {
+            machine->out() << "No such item!" <<endl;
+            return machine->getHasCoinState(); // Stay in same state
+        }
+        if (machine->isSlotSoldOut(slot)) {
+            machine->out() << "Item sold out! Please choose another item." <<endl;
+            return machine->getHasCoinState(); // Stay in same state
+        }
+
+        int price = machine->getPrice(slot);
+        if (machine->getInsertedCoin() >= price) {
+            int change = machine->getInsertedCoin() - price;
+            string coins;
+            if (!machine->giveChange(change, coins)) {
+                machine->out() << "Cannot return change of Rs " << change
+                               << ". Choose another item or take your coins back." <<endl;
+                return machine->getHasCoinState(); // Stay in same state
+            }
+           machine->out() << "Item selected. Dispensing..." <<endl;
             
-            int change = machine->getInsertedCoin() - machine->getPrice();
             if (change > 0) {
-               cout << "Change returned: Rs " << change <<endl;
+               machine->out() << "Change returned: Rs " << change << (coins.empty() ? "" : " (" + coins + ")") <<endl;
             }
             machine->setInsertedCoin(0);
+            machine->setSelectedSlot(slot);
             
             return machine->getDispenseState(); // Transition to DispenseState
         } 
         else {
-            int needed = machine->getPrice() - machine->getInsertedCoin();
-            cout << "Insufficient funds. Need Rs " << needed << " more." <<endl;
+            int needed = price - machine->getInsertedCoin();
+            machine->out() << "Insufficient funds. Need Rs " << needed << " more." <<endl;
             return machine->getHasCoinState(); // Stay in same state
         }
     }
     
     VendingState* dispense(VendingMachine* machine) override {
-       cout << "Please select an item first!" <<endl;
+       machine->out() << "Please select an item first!" <<endl;
         return machine->getHasCoinState(); // Stay in same state
     }
     
     VendingState* returnCoin(VendingMachine* machine) override {
-       cout << "Coin returned: Rs " << machine->getInsertedCoin() <<endl;
+        // Always possible: the inserted coins are still in the coin box
+        string coins;
+        machine->giveChange(machine->getInsertedCoin(), coins);
+       machine->out() << "Coin returned: Rs " << machine->getInsertedCoin() << (coins.empty() ? "" : " (" + coins + ")") <<endl;
         machine->setInsertedCoin(0);
         return machine->getNoCoinState(); // Transition to NoCoinState
     }
 
-    VendingState* refill(VendingMachine* machine, int quantity) override {
-        cout << "Can't refil in this state" <<endl;
+    VendingState* refill(VendingMachine* machine, int, int) override {
+        machine->out() << "Can't refil in this state" <<endl;
         return machine->getHasCoinState(); // Stay in same state
     }
     
    string getStateName() override {
         return "HAS_COIN";
     }
+
+    VendingStateId getStateId() override {
+        return VendingStateId::HAS_COIN;
+    }
 };
 
 // Concrete State: Item Sold
 class DispenseState : public VendingState {
 public:
     VendingState* insertCoin(VendingMachine* machine, int coin) override {
-       cout << "Please wait, already dispensing item. Coin returned: Rs " << coin <<endl;
+       machine->out() << "Please wait, already dispensing item. Coin returned: Rs " << coin <<endl;
         return machine->getDispenseState();  // Stay in same state
     }
     
-    VendingState* selectItem(VendingMachine* machine) override {
-       cout << "Already dispensing item. Please wait." <<endl;
+    VendingState* selectItem(VendingMachine* machine, int) override {
+       machine->out() << "Already dispensing item. Please wait." <<endl;
         return machine->getDispenseState(); // Stay in same state
     }
     
     VendingState* dispense(VendingMachine* machine) override {
-       cout << "Item dispensed!" <<endl;
-        machine->decrementItemCount();
+       machine->out() << "Item dispensed!" <<endl;
+        int slot = machine->getSelectedSlot();
+        machine->removeSelectedItem();
         
-        if (machine->getItemCount() > 0) {
+        if (!machine->isSoldOut()) {
+            if (machine->isSlotSoldOut(slot)) {
+                machine->out() << "Slot " << slot << " is now sold out!" <<endl;
+            }
             return machine->getNoCoinState(); // Transition to NoCoinState
         } 
         else {
-           cout << "Machine is now sold out!" <<endl;
+           machine->out() << "Machine is now sold out!" <<endl;
             return machine->getSoldOutState(); // Transition to SoldOutState
         }
     }
     
     VendingState* returnCoin(VendingMachine* machine) override {
-       cout << "Cannot return coin while dispensing item!" <<endl;
+       machine->out() << "Cannot return coin while dispensing item!" <<endl;
         return machine->getDispenseState(); // Stay in same state
     }
 
-    VendingState* refill(VendingMachine* machine, int quantity) override {
-        cout << "Can't refil in this state" <<endl;
+    VendingState* refill(VendingMachine* machine, int, int) override {
+        machine->out() << "Can't refil in this state" <<endl;
         return machine->getDispenseState(); // Stay in same state
     }
 
    string getStateName() override {
         return "DISPENSING";
     }
+
+    VendingStateId getStateId() override {
+        return VendingStateId::DISPENSING;
+    }
 };
 
 // Concrete State: Sold Out
 class SoldOutState : public VendingState {
 public:
     VendingState* insertCoin(VendingMachine* machine, int coin) override {
-       cout << "Machine is sold out. Coin returned: Rs " << coin <<endl;
+       machine->out() << "Machine is sold out. Coin returned: Rs " << coin <<endl;
         return machine->getSoldOutState(); // Stay in same state
     }
     
-    VendingState* selectItem(VendingMachine* machine) override {
-       cout << "Machine is sold out!" <<endl;
+    VendingState* selectItem(VendingMachine* machine, int) override {
+       machine->out() << "Machine is sold out!" <<endl;
         return machine->getSoldOutState(); // Stay in same state
     }
     
     VendingState* dispense(VendingMachine* machine) override {
-       cout << "Machine is sold out!" <<endl;
+       machine->out() << "Machine is sold out!" <<endl;
         return machine->getSoldOutState(); // Stay in same state
     }
     
     VendingState* returnCoin(VendingMachine* machine) override {
-       cout << "Machine is sold out. No coin inserted." <<endl;
+       machine->out() << "Machine is sold out. No coin inserted." <<endl;
         return machine->getSoldOutState(); // Stay in same state
     }
 
-    VendingState* refill(VendingMachine* machine, int quantity) override {
-        cout << "Items refilling" <<endl;
-        machine->incrementItemCount(quantity);
-        return machine->getNoCoinState();
+    VendingState* refill(VendingMachine* machine, int slot, int quantity) override {
+        if (!machine->restock(slot, quantity)) {
+            machine->out() << "Slot " << slot << " cannot take " << quantity << " more items" <<endl;
+            return machine->getSoldOutState(); // Stay in same state
+        }
+        machine->out() << "Items refilling" <<endl;
+        return machine->isSoldOut() ? machine->getSoldOutState() : machine->getNoCoinState();
     }
     
    string getStateName() override {
         return "SOLD_OUT";
     }
+
+    VendingStateId getStateId() override {
+        return VendingStateId::SOLD_OUT;
+    }
 };
 
 // VendingMachine implementation (after all classes are defined)
-VendingMachine::VendingMachine(int itemCount, int itemPrice) {
+VendingMachine::VendingMachine(const PriceList* prices, int itemsPerSlot) {
 
-    this->itemCount = itemCount;
-    this->itemPrice = itemPrice;
+    this->prices = prices;
+    this->slotCounts.reset(new int32_t[prices->slotCount()]());
+    this->soldOutSlots = allSlots();
     this->insertedCoins = 0; 
+    this->selectedSlot = 0;
+    this->output = &cout;
     
-    // Create state objects
-    noCoinState = new NoCoinState();
-    hasCoinState = new HasCoinState();
-    dispenseState = new DispenseState();
-    soldOutState = new SoldOutState();
+    for (int slot = 0; slot < prices->slotCount(); slot++) {
+        restock(slot, itemsPerSlot);
+    }
     
     // Set initial state
-    if (itemCount  > 0) {
-        currentState = noCoinState;
+    if (!isSoldOut()) {
+        currentState = getNoCoinState();
     } else {
-        currentState = soldOutState;
+        currentState = getSoldOutState();
     }
 }
 
+VendingMachine::VendingMachine(int itemCount, int itemPrice)
+    : VendingMachine(PriceList::of({itemPrice}), itemCount) {}
+
+VendingState* VendingMachine::getNoCoinState() {
+    static NoCoinState state;
+    return &state;
+}
+
+VendingState* VendingMachine::getHasCoinState() {
+    static HasCoinState state;
+    return &state;
+}
+
+VendingState* VendingMachine::getDispenseState() {
+    static DispenseState state;
+    return &state;
+}
+
+VendingState* VendingMachine::getSoldOutState() {
+    static SoldOutState state;
+    return &state;
+}
+
 void VendingMachine::insertCoin(int coin) {
     currentState = currentState->insertCoin(this, coin);
 }
 
-void VendingMachine::selectItem() {
-    currentState = currentState->selectItem(this);
+void VendingMachine::selectItem(int slot) {
+    currentState = currentState->selectItem(this, slot);
 }
 
 void VendingMachine::dispense() {
@@ -288,17 +759,1143 @@ void VendingMachine::returnCoin() {
 }
 
 void VendingMachine::refill(int quantity) {
-    currentState = currentState->refill(this, quantity);
+    refill(0, quantity);
+}
+
+void VendingMachine::refill(int slot, int quantity) {
+    currentState = currentState->refill(this, slot, quantity);
 }
 
 void VendingMachine::printStatus() {
-    cout << "\n--- Vending Machine Status ---" << endl;
-    cout << "Items remaining: " << itemCount << endl;
-    cout << "Inserted coin: Rs " << insertedCoins << endl;
-    cout << "Current state: " << currentState->getStateName() << endl << endl;
+    out() << "\n--- Vending Machine Status ---" << endl;
+    out() << "Items remaining: " << getItemCount() << endl;
+    if (getSlotCount() > 1) {
+        for (int slot = 0; slot < getSlotCount(); slot++) {
+            out() << "  Slot " << slot << ": " << getItemCount(slot) << " x Rs " << getPrice(slot)
+                 << (isSlotSoldOut(slot) ? " (sold out)" : "") << endl;
+        }
+    }
+    out() << "Inserted coin: Rs " << insertedCoins << endl;
+    out() << "Current state: " << currentState->getStateName() << endl << endl;
+}
+
+// ---------------- Concurrent mode ----------------
+// One controller serves many kiosks at once, so events for the same machine can
+// arrive from several threads. Instead of state objects and separate fields, the
+// whole machine lives in one atomic word and every event is a pure step from one
+// packed state to the next, published with compare-and-swap.
+
+// Unpacked view of the machine word
+struct VendingSnapshot {
+    VendingStateId state;
+    uint32_t coins;
+    uint32_t items;
+};
+
+// What one event did, taken from the compare-and-swap that applied it
+struct VendingTransition {
+    VendingStateId from;
+    VendingSnapshot after;
+    uint32_t returned = 0; // coins handed back: change, a refund or a rejected coin
+    bool changed = false;  // false = event rejected in `from`, machine untouched
+};
+
+// Word layout: state in bits 56-63, inserted coins in bits 32-55, items in bits 0-31.
+// Transitions mirror the State pattern classes above, without the console output.
+class ConcurrentVendingMachine {
+private:
+    static const uint32_t MAX_COINS = (1u << 24) - 1;
+
+    atomic<uint64_t> word;
+    const uint32_t itemPrice;
+
+    static uint64_t pack(VendingSnapshot snapshot) {
+        return ((uint64_t)snapshot.state << 56) | ((uint64_t)snapshot.coins << 32) | snapshot.items;
+    }
+
+    static VendingSnapshot unpack(uint64_t word) {
+        return {(VendingStateId)(word >> 56), (uint32_t)(word >> 32) & MAX_COINS, (uint32_t)word};
+    }
+
+    // `step` edits the snapshot and returns true if the event is accepted. A rejected
+    // event writes nothing: it was decided on a consistent snapshot, which is enough.
+    template <typename Step>
+    VendingTransition apply(Step step) {
+        uint64_t current = word.load(memory_order_acquire);
+        for (;;) {
+            VendingTransition transition;
+            VendingSnapshot next = unpack(current);
+            transition.from = next.state;
+            transition.changed = step(next, transition.returned);
+            transition.after = transition.changed ? next : unpack(current);
+            if (!transition.changed) {
+                return transition;
+            }
+            if (word.compare_exchange_weak(current, pack(next), memory_order_acq_rel, memory_order_acquire)) {
+                return transition;
+            }
+        }
+    }
+
+public:
+    ConcurrentVendingMachine(uint32_t itemCount, uint32_t itemPrice) : itemPrice(itemPrice) {
+        VendingStateId state = itemCount > 0 ? VendingStateId::NO_COIN : VendingStateId::SOLD_OUT;
+        word.store(pack({state, 0, itemCount}));
+    }
+
+    VendingTransition insertCoin(uint32_t coin) {
+        return apply([&](VendingSnapshot& machine, uint32_t& returned) {
+            bool accepts = machine.state == VendingStateId::NO_COIN || machine.state == VendingStateId::HAS_COIN;
+            if (!accepts || coin == 0 || coin > MAX_COINS - machine.coins) {
+                returned = coin; // dispensing, sold out, or the coin counter would overflow
+                return false;
+            }
+            machine.coins += coin;
+            machine.state = VendingStateId::HAS_COIN;
+            return true;
+        });
+    }
+
+    VendingTransition selectItem() {
+        return apply([&](VendingSnapshot& machine, uint32_t& returned) {
+            if (machine.state != VendingStateId::HAS_COIN || machine.coins < itemPrice) {
+                return false;
+            }
+            returned = machine.coins - itemPrice; // change
+            machine.coins = 0;
+            machine.state = VendingStateId::DISPENSING;
+            return true;
+        });
+    }
+
+    VendingTransition dispense() {
+        return apply([&](VendingSnapshot& machine, uint32_t&) {
+            if (machine.state != VendingStateId::DISPENSING) {
+                return false;
+            }
+            machine.items--;
+            machine.state = machine.items > 0 ? VendingStateId::NO_COIN : VendingStateId::SOLD_OUT;
+            return true;
+        });
+    }
+
+    VendingTransition returnCoin() {
+        return apply([&](VendingSnapshot& machine, uint32_t& returned) {
+            if (machine.state != VendingStateId::HAS_COIN) {
+                return false;
+            }
+            returned = machine.coins;
+            machine.coins = 0;
+            machine.state = VendingStateId::NO_COIN;
+            return true;
+        });
+    }
+
+    VendingTransition refill(uint32_t quantity) {
+        return apply([&](VendingSnapshot& machine, uint32_t&) {
+            bool accepts = machine.state == VendingStateId::NO_COIN || machine.state == VendingStateId::SOLD_OUT;
+            if (!accepts || quantity == 0 || quantity > UINT32_MAX - machine.items) {
+                return false;
+            }
+            machine.items += quantity;
+            machine.state = VendingStateId::NO_COIN;
+            return true;
+        });
+    }
+
+    VendingSnapshot getSnapshot() const {
+        return unpack(word.load(memory_order_acquire));
+    }
+
+    uint32_t getPrice() const {
+        return itemPrice;
+    }
+
+    void printStatus() const {
+        VendingSnapshot snapshot = getSnapshot();
+        cout << "\n--- Vending Machine Status ---" << endl;
+        cout << "Items remaining: " << snapshot.items << endl;
+        cout << "Inserted coin: Rs " << snapshot.coins << endl;
+        cout << "Current state: " << vendingStateName(snapshot.state) << endl << endl;
+    }
+};
+
+// Shape every published state must have
+bool isConsistent(const VendingSnapshot& machine) {
+    switch (machine.state) {
+        case VendingStateId::NO_COIN: return machine.coins == 0 && machine.items > 0;
+        case VendingStateId::HAS_COIN: return machine.coins > 0 && machine.items > 0;
+        case VendingStateId::DISPENSING: return machine.coins == 0 && machine.items > 0;
+        case VendingStateId::SOLD_OUT: return machine.coins == 0 && machine.items == 0;
+    }
+    return false;
+}
+
+// Many threads fire random events at a few shared machines, then the books are
+// checked: every coin put in was either kept for a sale, handed back or is still
+// inserted, and every item stocked was either sold or is still in the machine.
+int runStressTest() {
+    const int machineCount = 4;
+    const int eventsPerThread = 500000;
+    const uint32_t itemPrice = 20;
+    const uint32_t initialItems = 50;
+    unsigned threadCount = max(8u, thread::hardware_concurrency());
+
+    vector<ConcurrentVendingMachine*> machines;
+    for (int m = 0; m < machineCount; m++) {
+        machines.push_back(new ConcurrentVendingMachine(initialItems, itemPrice));
+    }
+
+    // Per thread, per machine tallies; summed after the threads finish
+    struct Books {
+        uint64_t inserted = 0;
+        uint64_t returned = 0;
+        uint64_t sales = 0;     // selects accepted
+        uint64_t dispensed = 0;
+        uint64_t refilled = 0;
+        uint64_t inconsistent = 0;
+    };
+    vector<vector<Books>> books(threadCount, vector<Books>(machineCount));
+
+    auto worker = [&](unsigned t) {
+        mt19937 rng(t + 1);
+        for (int e = 0; e < eventsPerThread; e++) {
+            int m = rng() % machineCount;
+            ConcurrentVendingMachine* machine = machines[m];
+            Books& mine = books[t][m];
+            VendingTransition transition;
+            int kind = rng() % 100;
+            if (kind < 40) {
+                uint32_t coin = (rng() % 2) ? 10 : 5;
+                mine.inserted += coin;
+                transition = machine->insertCoin(coin);
+            } else if (kind < 70) {
+                transition = machine->selectItem();
+                if (transition.changed) mine.sales++;
+            } else if (kind < 90) {
+                transition = machine->dispense();
+                if (transition.changed) mine.dispensed++;
+            } else if (kind < 98) {
+                transition = machine->returnCoin();
+            } else {
+                uint32_t quantity = 1 + rng() % 10;
+                transition = machine->refill(quantity);
+                if (transition.changed) mine.refilled += quantity;
+            }
+            mine.returned += transition.returned;
+            if (!isConsistent(transition.after)) mine.inconsistent++;
+        }
+    };
+
+    auto start = chrono::steady_clock::now();
+    vector<thread> threads;
+    for (unsigned t = 0; t < threadCount; t++) {
+        threads.emplace_back(worker, t);
+    }
+    for (thread& t : threads) {
+        t.join();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    bool ok = true;
+    for (int m = 0; m < machineCount; m++) {
+        Books total;
+        for (unsigned t = 0; t < threadCount; t++) {
+            const Books& mine = books[t][m];
+            total.inserted += mine.inserted;
+            total.returned += mine.returned;
+            total.sales += mine.sales;
+            total.dispensed += mine.dispensed;
+            total.refilled += mine.refilled;
+            total.inconsistent += mine.inconsistent;
+        }
+        VendingSnapshot last = machines[m]->getSnapshot();
+        uint64_t pending = last.state == VendingStateId::DISPENSING ? 1 : 0; // paid, not yet dispensed
+        bool coinsBalance = total.inserted == total.returned + total.sales * itemPrice + last.coins;
+        bool itemsBalance = initialItems + total.refilled == total.dispensed + last.items;
+        bool salesBalance = total.sales == total.dispensed + pending;
+        bool machineOk = coinsBalance && itemsBalance && salesBalance && total.inconsistent == 0 && isConsistent(last);
+        ok = ok && machineOk;
+
+        cout << "Machine " << m << ": " << total.sales << " sales, " << total.refilled << " items refilled, "
+             << "final state " << vendingStateName(last.state) << " (" << last.items << " items, Rs "
+             << last.coins << " inserted) - " << (machineOk ? "books balance" : "BOOKS DO NOT BALANCE") << endl;
+    }
+    cout << threadCount << " threads x " << eventsPerThread << " events in " << seconds << " s ("
+         << (uint64_t)(threadCount * eventsPerThread / seconds) << " events/s)" << endl;
+    cout << (ok ? "Stress test passed" : "Stress test FAILED") << endl;
+
+    for (ConcurrentVendingMachine* machine : machines) {
+        delete machine;
+    }
+    return ok ? 0 : 1;
+}
+
+// ---------------- Table-driven mode ----------------
+// Generic state machine driven by a transition table instead of state objects.
+// A Spec provides:
+//   State, Event         enums numbered from 0
+//   STATE_COUNT, EVENT_COUNT
+//   Context              the machine's data, with an `ostream* out` (nullptr = quiet)
+//   table                constexpr TableCell[STATE_COUNT][EVENT_COUNT]
+// Each cell is picked at compile time per (state, event) pair, so its action is a
+// direct call the compiler can inline: no virtual dispatch and no heap allocation.
+template <typename Context, typename State>
+struct TableCell {
+    bool (*action)(Context&, int); // the result picks the next state
+    const char* message;           // printed before the action, nullptr = none
+    State onTrue;
+    State onFalse;
+
+    // Action of cells that only print their message
+    static bool keep(Context&, int) {
+        return true;
+    }
+};
+
+template <typename Spec>
+class TableStateMachine {
+public:
+    using State = typename Spec::State;
+    using Event = typename Spec::Event;
+    using Context = typename Spec::Context;
+
+    Context context;
+
+private:
+    State state;
+
+    template <size_t S, size_t E>
+    void step(int arg) {
+        // A constant, so the message check folds away and the action is a direct call
+        constexpr TableCell<Context, State> cell = Spec::table[S][E];
+        if (cell.message && context.out) {
+            *context.out << cell.message << "\n";
+        }
+        state = cell.action(context, arg) ? cell.onTrue : cell.onFalse;
+    }
+
+    // Expands to one comparison per state, each calling its own step()
+    template <size_t E, size_t... S>
+    void fireIn(index_sequence<S...>, int arg) {
+        ((state == (State)S ? (step<S, E>(arg), true) : false) || ...);
+    }
+
+    template <size_t... E>
+    void fireAny(Event event, int arg, index_sequence<E...>) {
+        (((size_t)event == E ? (fire<(Event)E>(arg), true) : false) || ...);
+    }
+
+public:
+    TableStateMachine(State initial, const Context& context) : context(context), state(initial) {}
+
+    template <Event E>
+    void fire(int arg = 0) {
+        fireIn<(size_t)E>(make_index_sequence<Spec::STATE_COUNT>(), arg);
+    }
+
+    // For events only known at run time (e.g. read from a log)
+    void fire(Event event, int arg = 0) {
+        fireAny(event, arg, make_index_sequence<Spec::EVENT_COUNT>());
+    }
+
+    State getState() const {
+        return state;
+    }
+};
+
+enum class VendingEvent : uint8_t {
+    INSERT_COIN,
+    SELECT_ITEM,
+    DISPENSE,
+    RETURN_COIN,
+    REFILL
+};
+
+struct VendingContext {
+    int itemCount;
+    int itemPrice;
+    int insertedCoins;
+    ostream* out;
+};
+
+// Actions of the vending table; each prints what the matching State class prints
+struct VendingActions {
+    using State = VendingStateId;
+    using Context = VendingContext;
+
+    static bool firstCoin(Context& machine, int coin) {
+        machine.insertedCoins = coin;
+        if (machine.out) *machine.out << "Coin inserted. Current balance: Rs " << coin << "\n";
+        return true;
+    }
+
+    static bool addCoin(Context& machine, int coin) {
+        machine.insertedCoins += coin;
+        if (machine.out) *machine.out << "Additional coin inserted. Current balance: Rs " << machine.insertedCoins << "\n";
+        return true;
+    }
+
+    static bool busyRejectsCoin(Context& machine, int coin) {
+        if (machine.out) *machine.out << "Please wait, already dispensing item. Coin returned: Rs " << coin << "\n";
+        return true;
+    }
+
+    static bool soldOutRejectsCoin(Context& machine, int coin) {
+        if (machine.out) *machine.out << "Machine is sold out. Coin returned: Rs " << coin << "\n";
+        return true;
+    }
+
+    // true = paid, go dispense
+    static bool pay(Context& machine, int) {
+        if (machine.insertedCoins < machine.itemPrice) {
+            if (machine.out) *machine.out << "Insufficient funds. Need Rs " << machine.itemPrice - machine.insertedCoins << " more.\n";
+            return false;
+        }
+        if (machine.out) {
+            *machine.out << "Item selected. Dispensing...\n";
+            int change = machine.insertedCoins - machine.itemPrice;
+            if (change > 0) *machine.out << "Change returned: Rs " << change << "\n";
+        }
+        machine.insertedCoins = 0;
+        return true;
+    }
+
+    // true = items left
+    static bool dispenseItem(Context& machine, int) {
+        if (machine.out) *machine.out << "Item dispensed!\n";
+        machine.itemCount--;
+        if (machine.itemCount > 0) return true;
+        if (machine.out) *machine.out << "Machine is now sold out!\n";
+        return false;
+    }
+
+    static bool returnCoins(Context& machine, int) {
+        if (machine.out) *machine.out << "Coin returned: Rs " << machine.insertedCoins << "\n";
+        machine.insertedCoins = 0;
+        return true;
+    }
+
+    static bool refillItems(Context& machine, int quantity) {
+        if (machine.out) *machine.out << "Items refilling\n";
+        machine.itemCount += quantity;
+        return true;
+    }
+
+    // A cell that always moves to `next`, and one that stays put with a message
+    static constexpr TableCell<Context, State> go(bool (*action)(Context&, int), State next) {
+        return {action, nullptr, next, next};
+    }
+    static constexpr TableCell<Context, State> stay(State state, const char* message) {
+        return {TableCell<Context, State>::keep, message, state, state};
+    }
+};
+
+// The vending machine as a table: same transitions and messages as the State classes
+struct VendingSpec : VendingActions {
+    using Event = VendingEvent;
+    static const size_t STATE_COUNT = 4;
+    static const size_t EVENT_COUNT = 5;
+
+    static constexpr State NO_COIN = State::NO_COIN;
+    static constexpr State HAS_COIN = State::HAS_COIN;
+    static constexpr State DISPENSING = State::DISPENSING;
+    static constexpr State SOLD_OUT = State::SOLD_OUT;
+
+    // Rows: states; columns: insertCoin, selectItem, dispense, returnCoin, refill
+    static constexpr TableCell<Context, State> table[STATE_COUNT][EVENT_COUNT] = {
+        { // NO_COIN
+            go(firstCoin, HAS_COIN),
+            stay(NO_COIN, "Please insert coin first!"),
+            stay(NO_COIN, "Please insert coin and select item first!"),
+            stay(NO_COIN, "No coin to return!"),
+            go(refillItems, NO_COIN),
+        },
+        { // HAS_COIN
+            go(addCoin, HAS_COIN),
+            {pay, nullptr, DISPENSING, HAS_COIN},
+            stay(HAS_COIN, "Please select an item first!"),
+            go(returnCoins, NO_COIN),
+            stay(HAS_COIN, "Can't refil in this state"),
+        },
+        { // DISPENSING
+            go(busyRejectsCoin, DISPENSING),
+            stay(DISPENSING, "Already dispensing item. Please wait."),
+            {dispenseItem, nullptr, NO_COIN, SOLD_OUT},
+            stay(DISPENSING, "Cannot return coin while dispensing item!"),
+            stay(DISPENSING, "Can't refil in this state"),
+        },
+        { // SOLD_OUT
+            go(soldOutRejectsCoin, SOLD_OUT),
+            stay(SOLD_OUT, "Machine is sold out!"),
+            stay(SOLD_OUT, "Machine is sold out!"),
+            stay(SOLD_OUT, "Machine is sold out. No coin inserted."),
+            go(refillItems, NO_COIN),
+        },
+    };
+};
+
+// Same interface as VendingMachine, backed by the table
+class TableVendingMachine {
+private:
+    TableStateMachine<VendingSpec> machine;
+
+public:
+    TableVendingMachine(int itemCount, int itemPrice, ostream* out = &cout)
+        : machine(itemCount > 0 ? VendingStateId::NO_COIN : VendingStateId::SOLD_OUT,
+                  VendingContext{itemCount, itemPrice, 0, out}) {}
+
+    void insertCoin(int coin) { machine.fire<VendingEvent::INSERT_COIN>(coin); }
+    void selectItem() { machine.fire<VendingEvent::SELECT_ITEM>(); }
+    void dispense() { machine.fire<VendingEvent::DISPENSE>(); }
+    void returnCoin() { machine.fire<VendingEvent::RETURN_COIN>(); }
+    void refill(int quantity) { machine.fire<VendingEvent::REFILL>(quantity); }
+
+    void handle(VendingEvent event, int arg = 0) {
+        machine.fire(event, arg);
+    }
+
+    VendingStateId getState() const {
+        return machine.getState();
+    }
+
+    int getItemCount() const {
+        return machine.context.itemCount;
+    }
+
+    int getInsertedCoin() const {
+        return machine.context.insertedCoins;
+    }
+
+    void printStatus() {
+        ostream* out = machine.context.out;
+        if (!out) return;
+        *out << "\n--- Vending Machine Status ---\n";
+        *out << "Items remaining: " << getItemCount() << "\n";
+        *out << "Inserted coin: Rs " << getInsertedCoin() << "\n";
+        *out << "Current state: " << vendingStateName(getState()) << "\n\n";
+    }
+};
+
+// Swallows everything written to it, so timings exclude the terminal
+class DiscardBuffer : public streambuf {
+protected:
+    int overflow(int c) override {
+        return c;
+    }
+    streamsize xsputn(const char*, streamsize count) override {
+        return count;
+    }
+};
+
+void handleEvent(VendingMachine& machine, VendingEvent event, int arg) {
+    switch (event) {
+        case VendingEvent::INSERT_COIN: machine.insertCoin(arg); break;
+        case VendingEvent::SELECT_ITEM: machine.selectItem(); break;
+        case VendingEvent::DISPENSE: machine.dispense(); break;
+        case VendingEvent::RETURN_COIN: machine.returnCoin(); break;
+        case VendingEvent::REFILL: machine.refill(arg); break;
+    }
+}
+
+// Random events in roughly the proportions a busy kiosk sees
+vector<pair<VendingEvent, int>> randomEvents(size_t count, unsigned seed) {
+    mt19937 rng(seed);
+    vector<pair<VendingEvent, int>> events;
+    events.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        int kind = rng() % 100;
+        if (kind < 40) events.push_back({VendingEvent::INSERT_COIN, (rng() % 2) ? 10 : 5});
+        else if (kind < 70) events.push_back({VendingEvent::SELECT_ITEM, 0});
+        else if (kind < 90) events.push_back({VendingEvent::DISPENSE, 0});
+        else if (kind < 98) events.push_back({VendingEvent::RETURN_COIN, 0});
+        else events.push_back({VendingEvent::REFILL, 1 + (int)(rng() % 10)});
+    }
+    return events;
+}
+
+// State pattern vs the table on the same event stream. Both are first checked to
+// print the same transcript; then output is discarded (or skipped) for timing.
+void benchmarkStateMachines() {
+    const size_t eventCount = 5000000;
+    vector<pair<VendingEvent, int>> events = randomEvents(eventCount, 7);
+
+    ostringstream patternText, tableText;
+    {
+        streambuf* console = cout.rdbuf(patternText.rdbuf());
+        VendingMachine pattern(50, 20);
+        TableVendingMachine table(50, 20, &tableText);
+        for (size_t i = 0; i < 100000; i++) {
+            handleEvent(pattern, events[i].first, events[i].second);
+            table.handle(events[i].first, events[i].second);
+        }
+        cout.rdbuf(console);
+    }
+    bool same = patternText.str() == tableText.str();
+
+    DiscardBuffer discard;
+    ostream discarded(&discard);
+    streambuf* console = cout.rdbuf(&discard);
+    auto timeMs = [&](auto run) {
+        auto start = chrono::steady_clock::now();
+        run();
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    };
+    VendingMachine pattern(50, 20);
+    double patternMs = timeMs([&] {
+        for (const auto& event : events) handleEvent(pattern, event.first, event.second);
+    });
+    // Both engines quiet, so only the dispatch differs
+    ostream silent(nullptr);
+    VendingMachine quietPattern(50, 20);
+    quietPattern.setOutput(&silent);
+    double quietPatternMs = timeMs([&] {
+        for (const auto& event : events) handleEvent(quietPattern, event.first, event.second);
+    });
+    TableVendingMachine printing(50, 20, &discarded);
+    double printingMs = timeMs([&] {
+        for (const auto& event : events) printing.handle(event.first, event.second);
+    });
+    TableVendingMachine quiet(50, 20, nullptr);
+    double quietMs = timeMs([&] {
+        for (const auto& event : events) quiet.handle(event.first, event.second);
+    });
+    cout.rdbuf(console);
+
+    cout << eventCount << " random events, transcripts " << (same ? "match" : "DIFFER") << endl;
+    cout << fixed << setprecision(1);
+    cout << "  State pattern, output discarded : " << setw(7) << patternMs << " ms, "
+         << setw(6) << eventCount / patternMs / 1000 << " M events/s" << endl;
+    cout << "  table, output discarded         : " << setw(7) << printingMs << " ms, "
+         << setw(6) << eventCount / printingMs / 1000 << " M events/s" << endl;
+    cout << "  State pattern, quiet            : " << setw(7) << quietPatternMs << " ms, "
+         << setw(6) << eventCount / quietPatternMs / 1000 << " M events/s" << endl;
+    cout << "  table, quiet                    : " << setw(7) << quietMs << " ms, "
+         << setw(6) << eventCount / quietMs / 1000 << " M events/s" << endl;
+}
+
+// Memory of a fleet of multi-slot machines. States are shared and price lists are
+// interned, so a machine costs its object plus a 4 byte count per slot (counts are
+// int32 so any int quantity the single product machine took still fits).
+void benchmarkFleetMemory() {
+    const int machineCount = 100000;
+    const int slotsPerMachine = 32;
+    const int layoutCount = 4; // distinct price lists across the fleet
+
+    vector<const PriceList*> layouts;
+    for (int layout = 0; layout < layoutCount; layout++) {
+        vector<int> prices;
+        for (int slot = 0; slot < slotsPerMachine; slot++) {
+            prices.push_back(10 + 5 * ((slot + layout) % 8));
+        }
+        layouts.push_back(PriceList::of(prices));
+    }
+
+    auto start = chrono::steady_clock::now();
+    vector<VendingMachine> fleet;
+    fleet.reserve(machineCount);
+    for (int m = 0; m < machineCount; m++) {
+        fleet.emplace_back(layouts[m % layoutCount], 10);
+    }
+    double buildMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    size_t machineBytes = 0;
+    for (VendingMachine& machine : fleet) {
+        machineBytes += machine.footprint();
+    }
+    size_t priceBytes = layoutCount * (sizeof(PriceList) + slotsPerMachine * sizeof(int));
+
+    cout << machineCount << " machines x " << slotsPerMachine << " slots, " << layoutCount
+         << " shared price lists, 4 shared state objects" << endl;
+    cout << fixed << setprecision(1);
+    cout << "  machines    : " << machineBytes / 1e6 << " MB (" << machineBytes / machineCount
+         << " bytes each, " << sizeof(VendingMachine) << " byte object + " << slotsPerMachine << " slot counts)" << endl;
+    cout << "  price lists : " << priceBytes << " bytes" << endl;
+    cout << "  built in " << buildMs << " ms (allocator overhead not included above)" << endl;
+}
+
+// ---------------- Fleet replay ----------------
+// Capacity planning: a recorded (or synthetic) event log is replayed against a fleet of
+// quiet machines to see how long they spend in each state and how long they sit sold out.
+
+// One entry of an event log
+struct FleetEvent {
+    uint32_t time;      // seconds since the log started
+    uint32_t machine;
+    VendingEvent type;
+    uint8_t slot;
+    uint16_t amount;    // coin value or refill quantity
+};
+static_assert(sizeof(FleetEvent) == 12, "log records are 12 bytes");
+
+// Every machine of the fleet is stocked the same way
+struct FleetConfig {
+    uint32_t machineCount;
+    int itemsPerSlot;
+    vector<int> prices;
+};
+
+struct FleetLog {
+    FleetConfig config;
+    vector<FleetEvent> events; // in time order
+};
+
+static const uint32_t FLEET_LOG_MAGIC = 0x31474C56; // "VLG1"
+
+// Layout: magic, machine count, items per slot, slot count, prices, event count, events
+void saveFleetLog(const FleetLog& log, const string& path) {
+    ofstream file(path, ios::binary);
+    uint32_t header[4] = {FLEET_LOG_MAGIC, log.config.machineCount, (uint32_t)log.config.itemsPerSlot,
+                          (uint32_t)log.config.prices.size()};
+    uint64_t count = log.events.size();
+    file.write((const char*)header, sizeof(header));
+    file.write((const char*)log.config.prices.data(), log.config.prices.size() * sizeof(int));
+    file.write((const char*)&count, sizeof(count));
+    file.write((const char*)log.events.data(), count * sizeof(FleetEvent));
+    if (!file) throw runtime_error("cannot write fleet log " + path);
+}
+
+FleetLog loadFleetLog(const string& path) {
+    ifstream file(path, ios::binary);
+    uint32_t header[4];
+    // The slot count is checked before anything is sized by it; replay threads build
+    // price lists from it and cannot report a bad one
+    if (!file.read((char*)header, sizeof(header)) || header[0] != FLEET_LOG_MAGIC ||
+        header[3] < 1 || header[3] > (uint32_t)PriceList::MAX_SLOTS) {
+        throw runtime_error(path + " is not a fleet log");
+    }
+    FleetLog log;
+    log.config.machineCount = header[1];
+    log.config.itemsPerSlot = header[2];
+    log.config.prices.resize(header[3]);
+    uint64_t count = 0;
+    file.read((char*)log.config.prices.data(), header[3] * sizeof(int));
+    file.read((char*)&count, sizeof(count));
+    log.events.resize(count);
+    file.read((char*)log.events.data(), count * sizeof(FleetEvent));
+    if (!file) throw runtime_error(path + " is truncated");
+    for (const FleetEvent& event : log.events) {
+        if (event.machine >= log.config.machineCount || event.slot >= header[3]) {
+            throw runtime_error(path + " refers to a machine or slot outside the fleet");
+        }
+    }
+    return log;
+}
+
+// Customers arrive at random with a per-machine busyness, prefer the first slots, pay
+// with 5/10/20 coins and either switch or walk away when their pick is sold out. A
+// service visit every 1-3 days tops every slot up. The generator keeps its own copy of
+// the stock so the log only contains what a customer could actually have done.
+FleetLog synthesizeFleetLog(uint32_t machineCount, uint32_t days, unsigned seed) {
+    FleetLog log;
+    log.config = {machineCount, 8, {10, 15, 20, 20, 25, 25, 30, 30, 35, 40, 45, 50}};
+    const int slotCount = log.config.prices.size();
+    const uint32_t end = days * 24 * 3600;
+    const int coins[] = {5, 10, 20};
+
+    vector<double> popularity;
+    for (int slot = 0; slot < slotCount; slot++) {
+        popularity.push_back(1.0 / (slot + 1));
+    }
+
+    for (uint32_t machine = 0; machine < machineCount; machine++) {
+        mt19937 rng(seed * 7919 + machine);
+        uniform_real_distribution<double> uniform(0.0, 1.0);
+        discrete_distribution<int> pickSlot(popularity.begin(), popularity.end());
+        double busy = uniform(rng);
+        exponential_distribution<double> arrivals((0.5 + 6 * busy * busy) / 3600); // customers per second
+        uint32_t refillEvery = (24 + rng() % 49) * 3600;
+        uint32_t nextRefill = rng() % refillEvery;
+        vector<int> stock(slotCount, log.config.itemsPerSlot);
+        int itemsLeft = slotCount * log.config.itemsPerSlot;
+
+        auto emit = [&](uint32_t time, VendingEvent type, int slot = 0, int amount = 0) {
+            log.events.push_back({time, machine, type, (uint8_t)slot, (uint16_t)amount});
+        };
+
+        double now = arrivals(rng);
+        uint32_t idleSince = 0; // end of the previous customer's visit
+        while (now < end) {
+            uint32_t t = (uint32_t)now;
+            while (nextRefill <= t) { // serviced once the previous customer has left
+                uint32_t visit = max(nextRefill, idleSince);
+                for (int slot = 0; slot < slotCount; slot++) {
+                    int missing = log.config.itemsPerSlot - stock[slot];
+                    if (missing > 0) {
+                        emit(visit, VendingEvent::REFILL, slot, missing);
+                        stock[slot] += missing;
+                        itemsLeft += missing;
+                    }
+                }
+                nextRefill += refillEvery;
+            }
+
+            if (uniform(rng) < 0.02) {
+                emit(t++, VendingEvent::SELECT_ITEM, pickSlot(rng)); // pressed before paying
+            }
+            int inserted = 0;
+            auto payFor = [&](int slot) {
+                while (inserted < log.config.prices[slot]) {
+                    int coin = coins[rng() % 3];
+                    emit(t++, VendingEvent::INSERT_COIN, 0, coin);
+                    inserted += coin;
+                }
+            };
+
+            int wanted = pickSlot(rng);
+            if (itemsLeft == 0) {
+                emit(t++, VendingEvent::INSERT_COIN, 0, coins[rng() % 3]); // handed straight back
+            } else {
+                payFor(wanted);
+                emit(t++, VendingEvent::SELECT_ITEM, wanted);
+                if (stock[wanted] == 0) {
+                    int other = wanted;
+                    if (uniform(rng) < 0.6) {
+                        for (int tries = 0; tries < 4 && stock[other] == 0; tries++) other = pickSlot(rng);
+                    }
+                    if (stock[other] == 0) {
+                        emit(t++, VendingEvent::RETURN_COIN);
+                        wanted = -1;
+                    } else {
+                        wanted = other;
+                        payFor(wanted);
+                        emit(t++, VendingEvent::SELECT_ITEM, wanted);
+                    }
+                }
+                if (wanted >= 0) {
+                    t += 2;
+                    emit(t++, VendingEvent::DISPENSE);
+                    stock[wanted]--;
+                    itemsLeft--;
+                }
+            }
+            idleSince = t;
+            now = max(now + arrivals(rng), (double)t);
+        }
+    }
+
+    // Machines were generated one after another; a recorded log interleaves them
+    stable_sort(log.events.begin(), log.events.end(), [](const FleetEvent& a, const FleetEvent& b) {
+        return a.time < b.time;
+    });
+    return log;
+}
+
+void handleEvent(VendingMachine& machine, const FleetEvent& event) {
+    switch (event.type) {
+        case VendingEvent::INSERT_COIN: machine.insertCoin(event.amount); break;
+        case VendingEvent::SELECT_ITEM: machine.selectItem(event.slot); break;
+        case VendingEvent::DISPENSE: machine.dispense(); break;
+        case VendingEvent::RETURN_COIN: machine.returnCoin(); break;
+        case VendingEvent::REFILL: machine.refill(event.slot, event.amount); break;
+    }
+}
+
+struct FleetReport {
+    uint64_t events = 0;
+    uint64_t sales = 0;
+    double stateSeconds[4] = {};      // machine-seconds spent in each VendingStateId
+    vector<uint32_t> soldOutPeriods;  // seconds, one per time a machine sold out
+    double slotSoldOutSeconds = 0;    // slot-seconds with an empty slot
+    uint64_t slotSoldOutPeriods = 0;
+
+    void merge(const FleetReport& other) {
+        events += other.events;
+        sales += other.sales;
+        for (int state = 0; state < 4; state++) stateSeconds[state] += other.stateSeconds[state];
+        soldOutPeriods.insert(soldOutPeriods.end(), other.soldOutPeriods.begin(), other.soldOutPeriods.end());
+        slotSoldOutSeconds += other.slotSoldOutSeconds;
+        slotSoldOutPeriods += other.slotSoldOutPeriods;
+    }
+};
+
+// Machine m is replayed by worker m % threadCount, which owns the machine, its quiet
+// output stream and its bookkeeping, so workers share nothing until the reports merge.
+// Periods still open at the last event of the log are closed there.
+FleetReport replayFleet(const FleetLog& log, unsigned threadCount) {
+    const FleetConfig& config = log.config;
+    const int slotCount = config.prices.size();
+    const uint32_t end = log.events.empty() ? 0 : log.events.back().time;
+
+    // Stable counting sort of the log by worker, keeping each machine's events in order
+    vector<size_t> offsets(threadCount + 1, 0);
+    for (const FleetEvent& event : log.events) offsets[event.machine % threadCount + 1]++;
+    for (unsigned t = 0; t < threadCount; t++) offsets[t + 1] += offsets[t];
+    vector<FleetEvent> partitioned(log.events.size());
+    vector<size_t> next(offsets.begin(), offsets.end() - 1);
+    for (const FleetEvent& event : log.events) partitioned[next[event.machine % threadCount]++] = event;
+
+    vector<FleetReport> reports(threadCount);
+    auto worker = [&](unsigned t) {
+        FleetReport& report = reports[t];
+        ostream quiet(nullptr);
+        const PriceList* prices = PriceList::of(config.prices);
+        size_t owned = config.machineCount / threadCount + (t < config.machineCount % threadCount ? 1 : 0);
+        vector<VendingMachine> machines;
+        machines.reserve(owned);
+        for (size_t i = 0; i < owned; i++) {
+            machines.emplace_back(prices, config.itemsPerSlot);
+            machines.back().setOutput(&quiet);
+        }
+        vector<uint32_t> enteredAt(owned, 0);
+        vector<uint32_t> slotEmptySince(owned * slotCount, 0);
+
+        for (size_t i = offsets[t]; i < offsets[t + 1]; i++) {
+            const FleetEvent& event = partitioned[i];
+            size_t local = event.machine / threadCount;
+            VendingMachine& machine = machines[local];
+            VendingStateId before = machine.getStateId();
+            uint64_t emptyBefore = machine.getSoldOutSlots();
+
+            handleEvent(machine, event);
+            report.events++;
+
+            VendingStateId after = machine.getStateId();
+            if (after != before) {
+                uint32_t dwell = event.time - enteredAt[local];
+                report.stateSeconds[(int)before] += dwell;
+                if (before == VendingStateId::SOLD_OUT) report.soldOutPeriods.push_back(dwell);
+                if (before == VendingStateId::DISPENSING) report.sales++;
+                enteredAt[local] = event.time;
+            }
+            uint64_t emptyAfter = machine.getSoldOutSlots();
+            if (emptyAfter != emptyBefore) {
+                for (int slot = 0; slot < slotCount; slot++) {
+                    uint64_t bit = 1ull << slot;
+                    if ((emptyAfter & bit) && !(emptyBefore & bit)) {
+                        slotEmptySince[local * slotCount + slot] = event.time;
+                        report.slotSoldOutPeriods++;
+                    } else if ((emptyBefore & bit) && !(emptyAfter & bit)) {
+                        report.slotSoldOutSeconds += event.time - slotEmptySince[local * slotCount + slot];
+                    }
+                }
+            }
+        }
+
+        for (size_t local = 0; local < owned; local++) {
+            VendingMachine& machine = machines[local];
+            uint32_t dwell = end - min(end, enteredAt[local]);
+            report.stateSeconds[(int)machine.getStateId()] += dwell;
+            if (machine.getStateId() == VendingStateId::SOLD_OUT) report.soldOutPeriods.push_back(dwell);
+            for (int slot = 0; slot < slotCount; slot++) {
+                if (machine.isSlotSoldOut(slot)) {
+                    report.slotSoldOutSeconds += end - min(end, slotEmptySince[local * slotCount + slot]);
+                }
+            }
+        }
+    };
+
+    vector<thread> threads;
+    for (unsigned t = 0; t < threadCount; t++) {
+        threads.emplace_back(worker, t);
+    }
+    for (thread& t : threads) {
+        t.join();
+    }
+    FleetReport total;
+    for (const FleetReport& report : reports) {
+        total.merge(report);
+    }
+    sort(total.soldOutPeriods.begin(), total.soldOutPeriods.end());
+    return total;
+}
+
+void printFleetReport(const FleetLog& log, const FleetReport& report) {
+    const FleetConfig& config = log.config;
+    double span = log.events.empty() ? 0 : log.events.back().time;
+    double machineSeconds = span * config.machineCount;
+    auto hours = [](double seconds) { return seconds / 3600; };
+
+    cout << fixed << setprecision(1);
+    cout << config.machineCount << " machines x " << config.prices.size() << " slots over "
+         << hours(span) / 24 << " days: " << report.events << " events, " << report.sales << " sales" << endl;
+    cout << "  state        machine-hours   share" << endl;
+    for (int state = 0; state < 4; state++) {
+        cout << "  " << left << setw(12) << vendingStateName((VendingStateId)state) << right
+             << setw(14) << hours(report.stateSeconds[state]) << setw(7)
+             << 100 * report.stateSeconds[state] / max(machineSeconds, 1.0) << "%" << endl;
+    }
+    const vector<uint32_t>& periods = report.soldOutPeriods;
+    cout << "  machine sold out: " << periods.size() << " times";
+    if (!periods.empty()) {
+        cout << ", hours p50 " << hours(periods[periods.size() / 2]) << ", p90 "
+             << hours(periods[periods.size() * 9 / 10]) << ", max " << hours(periods.back());
+    }
+    cout << endl;
+    cout << "  slot sold out: " << report.slotSoldOutPeriods << " times, " << hours(report.slotSoldOutSeconds)
+         << " slot-hours (" << 100 * report.slotSoldOutSeconds / max(machineSeconds * config.prices.size(), 1.0)
+         << "% of slot time)" << endl;
+}
+
+// Replays the log at 1, 2, 4... threads (up to the hardware), checks every run agrees
+int runFleetReplay(const FleetLog& log) {
+    unsigned hardwareThreads = max(1u, thread::hardware_concurrency());
+    FleetReport first;
+    bool same = true;
+    cout << "  threads    ms   M events/s" << endl;
+    for (unsigned threads = 1; threads <= max(4u, hardwareThreads); threads *= 2) {
+        auto start = chrono::steady_clock::now();
+        FleetReport report = replayFleet(log, threads);
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << "  " << setw(7) << threads << fixed << setprecision(0) << setw(6) << ms << setprecision(1)
+             << setw(13) << report.events / ms / 1000 << endl;
+        if (threads == 1) {
+            first = report;
+        } else {
+            same = same && report.sales == first.sales && report.soldOutPeriods == first.soldOutPeriods
+                   && report.slotSoldOutSeconds == first.slotSoldOutSeconds;
+        }
+    }
+    cout << "  reports " << (same ? "match" : "DIFFER") << " across thread counts" << endl << endl;
+    printFleetReport(log, first);
+    return same ? 0 : 1;
+}
+
+void benchmarkFleetReplay() {
+    auto start = chrono::steady_clock::now();
+    FleetLog log = synthesizeFleetLog(4000, 7, 1);
+    cout << "synthetic log: " << log.events.size() << " events in " << fixed << setprecision(0)
+         << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms" << endl;
+    runFleetReplay(log);
+}
+
+// Fewest coins for `amount` from `counts`, solved from scratch for every request:
+// the reference the change-making engine is checked and timed against
+int naiveFewestCoins(const CoinSystem* system, const vector<int>& counts, int amount) {
+    vector<int> fewest(amount + 1, INT32_MAX);
+    fewest[0] = 0;
+    for (int i = 0; i < system->size(); i++) {
+        for (int k = 0; k < counts[i]; k++) {
+            int value = system->value(i);
+            for (int left = amount; left >= value; left--) {
+                if (fewest[left - value] != INT32_MAX) {
+                    fewest[left] = min(fewest[left], fewest[left - value] + 1);
+                }
+            }
+        }
+    }
+    return fewest[amount];
+}
+
+// Customers pay for an item with random coins and take their change from the box,
+// which fills up with what they insert until the operator collects the cash
+void benchmarkChangeMaking() {
+    const int customers = 200000;
+    struct Setup {
+        const char* name;
+        vector<int> coins;
+        vector<int> prices;
+    };
+    vector<Setup> setups = {
+        {"canonical {20,10,5,2,1}", {20, 10, 5, 2, 1}, {12, 15, 17, 25, 33}},
+        {"non-canonical {10,4,3,1}", {10, 4, 3, 1}, {6, 9, 13, 14, 22}},
+    };
+    cout << fixed << setprecision(1);
+    for (const Setup& setup : setups) {
+        const CoinSystem* system = CoinSystem::of(setup.coins);
+        // The same customer stream for the engine and the reference
+        auto run = [&](bool reference, uint64_t& sales, uint64_t& refusals, uint64_t& coinsPaid,
+                       CoinInventory& box) {
+            mt19937 rng(7);
+            vector<int> plan;
+            vector<int> counts(system->size());
+            auto start = chrono::steady_clock::now();
+            for (int c = 0; c < customers; c++) {
+                if (c % 500 == 0) box.collect(10);
+                int price = setup.prices[rng() % setup.prices.size()];
+                int paid = 0;
+                while (paid < price) {
+                    int coin = system->value(rng() % system->size());
+                    box.accept(coin);
+                    paid += coin;
+                }
+                int change = paid - price;
+                bool ok;
+                if (reference) {
+                    for (int i = 0; i < system->size(); i++) counts[i] = box.countOf(system->value(i));
+                    int fewest = naiveFewestCoins(system, counts, change);
+                    ok = fewest != INT32_MAX;
+                    coinsPaid += ok ? fewest : 0;
+                    // Keep the box in step with the engine run
+                    if (ok) box.planChange(change, plan);
+                } else {
+                    ok = box.planChange(change, plan);
+                    if (ok) {
+                        for (int count : plan) coinsPaid += count;
+                    }
+                }
+                if (ok) {
+                    box.pay(plan);
+                    sales++;
+                } else {
+                    // Refused: the customer takes their coins back
+                    box.planChange(paid, plan);
+                    box.pay(plan);
+                    refusals++;
+                }
+            }
+            return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / customers;
+        };
+        vector<int> float_(system->size(), 0);
+        uint64_t sales = 0, refusals = 0, coins = 0;
+        uint64_t refSales = 0, refRefusals = 0, refCoins = 0;
+        CoinInventory engine(system, float_), reference(system, float_);
+        double engineNs = run(false, sales, refusals, coins, engine);
+        double referenceNs = run(true, refSales, refRefusals, refCoins, reference);
+        bool same = sales == refSales && refusals == refRefusals && coins == refCoins;
+        uint64_t lookups = engine.getFastPathHits() + engine.getTableLookups();
+        cout << setup.name << (system->isCanonical() ? "" : " (greedy not optimal)") << endl;
+        cout << "  " << customers << " customers, " << sales << " sales, " << refusals
+             << " refused for lack of change, " << coins << " coins paid out" << endl;
+        cout << "  fast path " << 100.0 * engine.getFastPathHits() / max<uint64_t>(lookups, 1) << "% of "
+             << lookups << " plans, " << engine.getTableBuilds() << " table builds" << endl;
+        cout << "  engine " << setw(8) << engineNs << " ns/customer, per-request DP " << setw(8)
+             << referenceNs << " ns/customer, results " << (same ? "match" : "DIFFER") << endl;
+    }
 }
 
-int main() {
+void runBenchmarks(const string& only) {
+    vector<pair<string, void (*)()>> benchmarks = {
+        {"states", benchmarkStateMachines},
+        {"fleet", benchmarkFleetMemory},
+        {"replay", benchmarkFleetReplay},
+        {"change", benchmarkChangeMaking},
+    };
+    for (auto& benchmark : benchmarks) {
+        if (only.empty() || only == benchmark.first) {
+            cout << "\n=== Benchmark: " << benchmark.first << " ===" << endl;
+            benchmark.second();
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    // "./main stress" runs the concurrent stress test instead of the demo scenario
+    if (argc > 1 && string(argv[1]) == "stress") {
+        return runStressTest();
+    }
+    // "./main record <log> [machines] [days]" writes a synthetic fleet log,
+    // "./main replay <log>" replays a recorded one
+    if (argc > 2 && string(argv[1]) == "record") {
+        FleetLog log = synthesizeFleetLog(argc > 3 ? stoi(argv[3]) : 4000, argc > 4 ? stoi(argv[4]) : 7, 1);
+        saveFleetLog(log, argv[2]);
+        cout << "Wrote " << log.events.size() << " events for " << log.config.machineCount << " machines" << endl;
+        return 0;
+    }
+    if (argc > 2 && string(argv[1]) == "replay") {
+        try {
+            return runFleetReplay(loadFleetLog(argv[2]));
+        } catch (const exception& error) {
+            cout << error.what() << endl;
+            return 1;
+        }
+    }
+    // "./main bench [name]" runs the benchmarks
+    if (argc > 1 && string(argv[1]) == "bench") {
+        runBenchmarks(argc > 2 ? argv[2] : "");
+        return 0;
+    }
+
     cout << "=== Water Bottle VENDING MACHINE ===" <<endl;
     
     int itemCount = 2;
@@ -344,6 +1941,35 @@ int main() {
     cout << "9. Trying to use sold out machine:" <<endl;
     machine.refill(2);
     machine.printStatus(); // State changes NO_COIN
+
+    cout << "10. Snack machine with three slots:" <<endl;
+    VendingMachine snacks(PriceList::of({20, 15, 30}), 1);
+    snacks.insertCoin(20);
+    snacks.selectItem(2);  // Rs 30 item, insufficient funds
+    snacks.selectItem(1);  // Rs 15 item, change returned
+    snacks.dispense();     // Slot 1 is now sold out
+    snacks.insertCoin(20);
+    snacks.selectItem(1);  // Sold out, choose another
+    snacks.selectItem(0);
+    snacks.dispense();
+    snacks.printStatus();
+
+    cout << "11. Machine that pays change from its own coins:" <<endl;
+    VendingMachine tea(PriceList::of({15}), 3);
+    tea.setCoinBox(CoinSystem::of({20, 10, 5}), {0, 2, 0});
+    tea.insertCoin(2);     // Not a coin this machine takes
+    tea.insertCoin(20);
+    tea.selectItem();      // Rs 5 change, but no Rs 5 coins
+    tea.returnCoin();
+    tea.getCoinBox()->load(5, 4);
+    tea.insertCoin(20);
+    tea.selectItem();      // Change paid from the coin box
+    tea.dispense();
+    tea.insertCoin(10);
+    tea.insertCoin(10);
+    tea.selectItem();
+    tea.dispense();
+    tea.printStatus();
     
     return 0;
 }
\ No newline at end of file
@@ -2,77 +2,834 @@
 #include <string>
 #include <map>
 #include <memory>
+#include <vector>
+#include <chrono>
+#include <iomanip>
+#include <functional>
+#include <utility>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <stdexcept>
+#include <atomic>
+#include <cstring>
+#include <cstdint>
+#include <random>
+#include <string_view>
+#include <algorithm>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 
 using namespace std;
 
+// Persistent ordered map: a write copies only the nodes on the path from the root to
+// the key and shares everything else with the previous version, so copying a whole
+// map is O(1) and old copies never see later writes. Nodes no copy can reach are
+// updated in place instead, so a map that is never copied does not allocate per write.
+// It is a treap whose priorities come from the key hash, so its shape depends only on
+// the keys it holds and stays O(log n) deep whatever order they arrive in.
+class PersistentMap {
+private:
+    struct Node;
+    using NodePtr = shared_ptr<const Node>;
+    struct Node {
+        string key;
+        string value;
+        size_t priority;
+        NodePtr left;
+        NodePtr right;
+    };
+
+    NodePtr root;
+    size_t count = 0;
+
+    static NodePtr make(const string& key, const string& value, size_t priority, NodePtr left, NodePtr right) {
+        return make_shared<const Node>(Node{key, value, priority, move(left), move(right)});
+    }
+
+    // A node that `mine` marks as reachable only from this map (it and every node above
+    // it have one owner) is changed in place; one a copy of the map can see is copied
+    static NodePtr withChildren(const NodePtr& node, bool mine, NodePtr left, NodePtr right) {
+        if (mine) {
+            Node* shared = const_cast<Node*>(node.get());
+            shared->left = move(left);
+            shared->right = move(right);
+            return node;
+        }
+        return make(node->key, node->value, node->priority, move(left), move(right));
+    }
+
+    // Returns the new subtree; `existed` is set (and the old value copied to `prior`, if
+    // given) when the key was there before. With `mustExist` an absent key leaves the
+    // tree alone and nullptr is returned. A subtree handed back is never shared with a
+    // copy, so rotations may change its root in place.
+    static NodePtr insert(const NodePtr& node, bool owned, const string& key, const string& value,
+                          size_t priority, bool mustExist, bool& existed, string* prior) {
+        if (!node) {
+            return mustExist ? nullptr : make(key, value, priority, nullptr, nullptr);
+        }
+        bool mine = owned && node.use_count() == 1;
+        int order = key.compare(node->key);
+        if (order == 0) {
+            existed = true;
+            if (prior) *prior = node->value;
+            if (mine) {
+                const_cast<Node*>(node.get())->value = value;
+                return node;
+            }
+            return make(key, value, node->priority, node->left, node->right);
+        }
+        if (order < 0) {
+            NodePtr left = insert(node->left, mine, key, value, priority, mustExist, existed, prior);
+            if (!left) return nullptr;
+            if (left->priority > node->priority) { // rotate right
+                return withChildren(left, true, left->left, withChildren(node, mine, left->right, node->right));
+            }
+            return withChildren(node, mine, move(left), node->right);
+        }
+        NodePtr right = insert(node->right, mine, key, value, priority, mustExist, existed, prior);
+        if (!right) return nullptr;
+        if (right->priority > node->priority) { // rotate left
+            return withChildren(right, true, withChildren(node, mine, node->left, right->left), right->right);
+        }
+        return withChildren(node, mine, node->left, move(right));
+    }
+
+    // Joins two subtrees where every key in `a` is below every key in `b`
+    static NodePtr merge(const NodePtr& a, const NodePtr& b) {
+        if (!a) return b;
+        if (!b) return a;
+        if (a->priority > b->priority) {
+            return withChildren(a, false, a->left, merge(a->right, b));
+        }
+        return withChildren(b, false, merge(a, b->left), b->right);
+    }
+
+    // Returns the new subtree, or `node` itself if the key was not found
+    static NodePtr erase(const NodePtr& node, bool owned, const string& key, bool& removed, string* prior) {
+        if (!node) return node;
+        bool mine = owned && node.use_count() == 1;
+        int order = key.compare(node->key);
+        if (order == 0) {
+            removed = true;
+            if (prior) *prior = node->value;
+            return merge(node->left, node->right);
+        }
+        if (order < 0) {
+            NodePtr left = erase(node->left, mine, key, removed, prior);
+            return removed ? withChildren(node, mine, move(left), node->right) : node;
+        }
+        NodePtr right = erase(node->right, mine, key, removed, prior);
+        return removed ? withChildren(node, mine, node->left, move(right)) : node;
+    }
+
+public:
+    // nullptr if the key is absent
+    const string* find(const string& key) const {
+        const Node* node = root.get();
+        while (node) {
+            int order = key.compare(node->key);
+            if (order == 0) return &node->value;
+            node = order < 0 ? node->left.get() : node->right.get();
+        }
+        return nullptr;
+    }
+
+    // Inserts or replaces; true if the key existed, and then `prior` (if given) gets the
+    // old value, read on the way down
+    bool set(const string& key, const string& value, string* prior = nullptr) {
+        bool existed = false;
+        root = insert(root, true, key, value, hash<string>()(key), false, existed, prior);
+        count += !existed;
+        return existed;
+    }
+
+    // Replaces an existing value only; false (and no change) if the key is absent
+    bool replace(const string& key, const string& value, string* prior = nullptr) {
+        bool existed = false;
+        NodePtr updated = insert(root, true, key, value, hash<string>()(key), true, existed, prior);
+        if (updated) root = move(updated);
+        return existed;
+    }
+
+    bool erase(const string& key, string* prior = nullptr) {
+        bool removed = false;
+        root = erase(root, true, key, removed, prior);
+        count -= removed;
+        return removed;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    // Visits the records in key order
+    template <typename Visitor>
+    void forEach(Visitor visit) const {
+        vector<const Node*> path;
+        const Node* node = root.get();
+        while (node || !path.empty()) {
+            for (; node; node = node->left.get()) {
+                path.push_back(node);
+            }
+            node = path.back();
+            path.pop_back();
+            visit(node->key, node->value);
+            node = node->right.get();
+        }
+    }
+};
+
+// CRC-32 (IEEE) of a byte range, used to spot torn or corrupt log frames
+uint32_t crc32(const char* data, size_t size) {
+    static const vector<uint32_t> table = [] {
+        vector<uint32_t> entries(256);
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc >> 1) ^ (crc & 1 ? 0xEDB88320u : 0);
+            }
+            entries[i] = crc;
+        }
+        return entries;
+    }();
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ (uint8_t)data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+// Write-ahead log of committed transactions. Each transaction is one frame:
+//   u32 payload size, u32 CRC-32 of the payload, payload
+// so recovery either sees a whole transaction or stops at a torn/corrupt frame and
+// cuts the file there. What the payload means is up to the Database.
+// commit() is safe to call from several threads and uses group commit: the first
+// committer to find no sync in progress becomes the leader, waits `window` for others
+// to queue their frames behind it, then writes them all with one fdatasync.
+class WriteAheadLog {
+private:
+    string path;
+    int fd;
+    chrono::microseconds window;
+
+    mutex logMutex;
+    condition_variable synced;
+    string pending;              // frames waiting for the next sync
+    uint64_t queuedFrames = 0;   // frames handed to commit(), in order
+    uint64_t durableFrames = 0;  // frames known to be on disk
+    bool syncing = false;        // a leader is writing
+    bool failed = false;         // a sync failed; nothing queued after it is durable
+    uint64_t syncCount = 0;
+
+    static void writeAll(int fd, const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t written = ::write(fd, data, size);
+            if (written < 0) throw runtime_error(string("log write failed: ") + strerror(errno));
+            data += written;
+            size -= written;
+        }
+    }
+
+public:
+    WriteAheadLog(const string& path, chrono::microseconds window = chrono::microseconds(0))
+        : path(path), window(window) {
+        fd = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+        if (fd < 0) {
+            throw runtime_error("cannot open log " + path + ": " + strerror(errno));
+        }
+    }
+
+    ~WriteAheadLog() {
+        close(fd);
+    }
+
+    // Hands every intact frame's payload to `apply`, oldest first, and truncates the
+    // file after the last one. Call before the first commit().
+    template <typename Apply>
+    uint64_t recover(Apply apply) {
+        struct stat info;
+        fstat(fd, &info);
+        string file(info.st_size, '\0');
+        if (pread(fd, &file[0], file.size(), 0) != (ssize_t)file.size()) {
+            throw runtime_error(string("log read failed: ") + strerror(errno));
+        }
+        size_t position = 0;
+        uint64_t frames = 0;
+        while (file.size() - position >= 8) {
+            uint32_t size, crc;
+            memcpy(&size, &file[position], 4);
+            memcpy(&crc, &file[position + 4], 4);
+            if (size > file.size() - position - 8 || crc32(&file[position + 8], size) != crc) break;
+            apply(&file[position + 8], size);
+            position += 8 + size;
+            frames++;
+        }
+        if (position < file.size() && ftruncate(fd, position) != 0) {
+            throw runtime_error(string("log truncate failed: ") + strerror(errno));
+        }
+        return frames;
+    }
+
+    // Appends one transaction and returns once it is on disk
+    void commit(const string& payload) {
+        uint32_t header[2] = {(uint32_t)payload.size(), crc32(payload.data(), payload.size())};
+        unique_lock<mutex> lock(logMutex);
+        pending.append((const char*)header, sizeof(header));
+        pending += payload;
+        uint64_t mine = ++queuedFrames;
+        while (durableFrames < mine) {
+            if (failed) {
+                throw runtime_error("log sync failed: " + path);
+            }
+            if (syncing) {
+                synced.wait(lock);
+                continue;
+            }
+            syncing = true;
+            if (window.count() > 0) {
+                lock.unlock();
+                this_thread::sleep_for(window);
+                lock.lock();
+            }
+            string batch;
+            batch.swap(pending);
+            uint64_t batchEnd = queuedFrames;
+            lock.unlock();
+            bool written = true;
+            try {
+                writeAll(fd, batch.data(), batch.size());
+                written = fdatasync(fd) == 0;
+            } catch (const runtime_error&) {
+                written = false;
+            }
+            lock.lock();
+            syncing = false;
+            failed = !written;
+            synced.notify_all();
+            if (failed) {
+                throw runtime_error("log sync failed: " + path);
+            }
+            durableFrames = batchEnd;
+            syncCount++;
+        }
+    }
+
+    uint64_t getSyncCount() {
+        lock_guard<mutex> lock(logMutex);
+        return syncCount;
+    }
+};
+
+// Storage engine - where a Database keeps its records, chosen at construction.
+// Every write is one call that also reports what the key held before (for the undo log),
+// so no write needs a separate lookup first.
+enum class StorageEngineType {
+    ORDERED, // persistent ordered map: O(log n), O(1) snapshots for mementos
+    HASH     // open-addressing hash table: O(1) point operations, mementos copy it
+};
+
+class StorageEngine {
+public:
+    virtual ~StorageEngine() {}
+
+    // The value stays valid until the next write
+    virtual bool find(const string& key, string_view& value) const = 0;
+    // Inserts or replaces; true if the key existed, and then `prior` (if given) gets
+    // the old value
+    virtual bool put(const string& key, const string& value, string* prior) = 0;
+    // Replaces an existing value only; false if the key is absent
+    virtual bool replace(const string& key, const string& value, string* prior) = 0;
+    virtual bool erase(const string& key, string* prior) = 0;
+    virtual size_t size() const = 0;
+    // In key order when isOrdered()
+    virtual void forEach(const function<void(const string&, string_view)>& visit) const = 0;
+    virtual bool isOrdered() const = 0;
+    // Independent copy for a memento
+    virtual unique_ptr<StorageEngine> clone() const = 0;
+
+    static unique_ptr<StorageEngine> create(StorageEngineType type);
+};
+
+class OrderedEngine : public StorageEngine {
+private:
+    PersistentMap records;
+
+public:
+    bool find(const string& key, string_view& value) const override {
+        const string* found = records.find(key);
+        if (found) value = *found;
+        return found != nullptr;
+    }
+
+    bool put(const string& key, const string& value, string* prior) override {
+        return records.set(key, value, prior);
+    }
+
+    bool replace(const string& key, const string& value, string* prior) override {
+        return records.replace(key, value, prior);
+    }
+
+    bool erase(const string& key, string* prior) override {
+        return records.erase(key, prior);
+    }
+
+    size_t size() const override {
+        return records.size();
+    }
+
+    void forEach(const function<void(const string&, string_view)>& visit) const override {
+        records.forEach([&](const string& key, const string& value) {
+            visit(key, value);
+        });
+    }
+
+    bool isOrdered() const override {
+        return true;
+    }
+
+    // O(1): the copy shares every node
+    unique_ptr<StorageEngine> clone() const override {
+        return unique_ptr<StorageEngine>(new OrderedEngine(*this));
+    }
+};
+
+// Linear-probing hash table of fixed 48 byte slots. Keys up to 24 bytes live inside the
+// slot; longer keys and all values are appended to one arena and referenced by offset.
+// A value that fits in its old bytes is overwritten in place; otherwise the old bytes
+// become garbage, and the arena is compacted once garbage outweighs live data.
+// Deletion shifts later entries of the probe run back, so there are no tombstones.
+class HashEngine : public StorageEngine {
+private:
+    static const uint32_t INLINE_KEY = 24;
+
+    struct Slot {
+        uint64_t hash;        // 0 = empty; stored hashes always have the top bit set
+        uint32_t keySize;
+        uint32_t valueSize;
+        uint64_t valueOffset; // in the arena
+        union {
+            char inlineKey[INLINE_KEY];
+            uint64_t keyOffset; // in the arena when keySize > INLINE_KEY
+        };
+    };
+
+    vector<Slot> slots;
+    size_t count = 0;
+    string arena;
+    size_t garbageBytes = 0;
+
+    static uint64_t hashOf(const string& key) {
+        return hash<string>()(key) | (1ull << 63);
+    }
+
+    string_view keyOf(const Slot& slot) const {
+        return slot.keySize <= INLINE_KEY ? string_view(slot.inlineKey, slot.keySize)
+                                          : string_view(arena.data() + slot.keyOffset, slot.keySize);
+    }
+
+    string_view valueOf(const Slot& slot) const {
+        return string_view(arena.data() + slot.valueOffset, slot.valueSize);
+    }
+
+    // Slot holding the key, or the empty slot that ends its probe run
+    size_t probe(const string& key, uint64_t hash) const {
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            const Slot& slot = slots[i];
+            if (slot.hash == 0 || (slot.hash == hash && keyOf(slot) == key)) return i;
+        }
+    }
+
+    uint64_t append(string_view bytes) {
+        uint64_t offset = arena.size();
+        arena.append(bytes.data(), bytes.size());
+        return offset;
+    }
+
+    void storeValue(Slot& slot, const string& value) {
+        if (value.size() <= slot.valueSize) {
+            memcpy(&arena[slot.valueOffset], value.data(), value.size());
+            garbageBytes += slot.valueSize - value.size();
+        } else {
+            garbageBytes += slot.valueSize;
+            slot.valueOffset = append(value);
+        }
+        slot.valueSize = value.size();
+    }
+
+    void forgetBytes(const Slot& slot) {
+        garbageBytes += slot.valueSize + (slot.keySize > INLINE_KEY ? slot.keySize : 0);
+    }
+
+    void grow() {
+        vector<Slot> old(slots.size() * 2);
+        old.swap(slots);
+        size_t mask = slots.size() - 1;
+        for (const Slot& slot : old) {
+            if (slot.hash == 0) continue;
+            size_t i = slot.hash & mask;
+            while (slots[i].hash != 0) i = (i + 1) & mask;
+            slots[i] = slot;
+        }
+    }
+
+    // Copies the live keys and values into a fresh arena
+    void compact() {
+        string fresh;
+        fresh.reserve(arena.size() - garbageBytes);
+        for (Slot& slot : slots) {
+            if (slot.hash == 0) continue;
+            if (slot.keySize > INLINE_KEY) {
+                uint64_t offset = fresh.size();
+                fresh.append(arena, slot.keyOffset, slot.keySize);
+                slot.keyOffset = offset;
+            }
+            uint64_t offset = fresh.size();
+            fresh.append(arena, slot.valueOffset, slot.valueSize);
+            slot.valueOffset = offset;
+        }
+        arena.swap(fresh);
+        garbageBytes = 0;
+    }
+
+    void compactIfWasteful() {
+        if (garbageBytes > (1 << 20) && garbageBytes * 2 > arena.size()) {
+            compact();
+        }
+    }
+
+public:
+    HashEngine() : slots(16) {}
+
+    bool find(const string& key, string_view& value) const override {
+        const Slot& slot = slots[probe(key, hashOf(key))];
+        if (slot.hash == 0) return false;
+        value = valueOf(slot);
+        return true;
+    }
+
+    bool put(const string& key, const string& value, string* prior) override {
+        uint64_t hash = hashOf(key);
+        size_t i = probe(key, hash);
+        if (slots[i].hash != 0) {
+            if (prior) prior->assign(valueOf(slots[i]));
+            storeValue(slots[i], value);
+            compactIfWasteful();
+            return true;
+        }
+        if ((count + 1) * 4 > slots.size() * 3) {
+            grow();
+            i = probe(key, hash);
+        }
+        Slot& slot = slots[i];
+        slot.hash = hash;
+        slot.keySize = key.size();
+        if (key.size() <= INLINE_KEY) {
+            memcpy(slot.inlineKey, key.data(), key.size());
+        } else {
+            slot.keyOffset = append(key);
+        }
+        slot.valueSize = value.size();
+        slot.valueOffset = append(value);
+        count++;
+        return false;
+    }
+
+    bool replace(const string& key, const string& value, string* prior) override {
+        size_t i = probe(key, hashOf(key));
+        if (slots[i].hash == 0) return false;
+        if (prior) prior->assign(valueOf(slots[i]));
+        storeValue(slots[i], value);
+        compactIfWasteful();
+        return true;
+    }
+
+    bool erase(const string& key, string* prior) override {
+        size_t mask = slots.size() - 1;
+        size_t hole = probe(key, hashOf(key));
+        if (slots[hole].hash == 0) return false;
+        if (prior) prior->assign(valueOf(slots[hole]));
+        forgetBytes(slots[hole]);
+        // Move back any later entry whose home is not between the hole and itself
+        for (size_t i = (hole + 1) & mask; slots[i].hash != 0; i = (i + 1) & mask) {
+            size_t home = slots[i].hash & mask;
+            if (((i - home) & mask) >= ((i - hole) & mask)) {
+                slots[hole] = slots[i];
+                hole = i;
+            }
+        }
+        slots[hole].hash = 0;
+        count--;
+        compactIfWasteful();
+        return true;
+    }
+
+    size_t size() const override {
+        return count;
+    }
+
+    void forEach(const function<void(const string&, string_view)>& visit) const override {
+        string key;
+        for (const Slot& slot : slots) {
+            if (slot.hash == 0) continue;
+            key.assign(keyOf(slot));
+            visit(key, valueOf(slot));
+        }
+    }
+
+    bool isOrdered() const override {
+        return false;
+    }
+
+    // O(n): copies the table and the arena
+    unique_ptr<StorageEngine> clone() const override {
+        return unique_ptr<StorageEngine>(new HashEngine(*this));
+    }
+};
+
+unique_ptr<StorageEngine> StorageEngine::create(StorageEngineType type) {
+    if (type == StorageEngineType::HASH) {
+        return unique_ptr<StorageEngine>(new HashEngine());
+    }
+    return unique_ptr<StorageEngine>(new OrderedEngine());
+}
+
 // Memento - Stores database state snapshot
+// With the ordered engine a memento shares every record with the database, so it costs
+// O(1) to take and to restore no matter how many records there are; a hash engine is
+// copied (use undo-log transactions with it).
 class DatabaseMemento {
 private:
-    map<string, string> data;
+    unique_ptr<StorageEngine> data;
+    size_t redoBytes; // uncommitted log output at the time
     
 public:
-    DatabaseMemento(const map<string, string>& dbData) {
-        this->data = dbData;
+    DatabaseMemento(unique_ptr<StorageEngine> dbData, size_t redoBytes) : redoBytes(redoBytes) {
+        this->data = move(dbData);
     }
     
-    map<string, string> getState() const {
-        return data;
+    const StorageEngine& getState() const {
+        return *data;
     }
+
+    size_t getRedoBytes() const {
+        return redoBytes;
+    }
+};
+
+// What a key held before a write, so the write can be undone
+struct UndoRecord {
+    string key;
+    bool existed;  // false = the write created the key
+    string value;
+    size_t redoBytes; // uncommitted log output before the write
 };
 
 // Originator - The database whose state we want to save/restore
 class Database {
 private:
-    map<string, string> records;
+    unique_ptr<StorageEngine> records;
+    ostream* output = &cout; // where operations are reported
+    bool logging = false;    // writes append to undoLog
+    vector<UndoRecord> undoLog;
+    // With a write-ahead log attached, writes are encoded into `redo` and written to the
+    // log as one transaction by commit():
+    //   u8 PUT, u32 key size, key, u32 value size, value  |  u8 ERASE, u32 key size, key
+    WriteAheadLog* wal = nullptr;
+    string redo;
+    enum RedoOp : uint8_t { PUT = 1, ERASE = 2 };
+
+    // `prior` is only filled in by the engine while logging
+    void logPrior(const string& key, bool existed, string& prior) {
+        if (logging) {
+            undoLog.push_back({key, existed, move(prior), redo.size()});
+        }
+    }
+
+    void appendString(const string& text) {
+        uint32_t size = text.size();
+        redo.append((const char*)&size, sizeof(size));
+        redo += text;
+    }
+
+    void logRedo(RedoOp op, const string& key, const string& value = "") {
+        if (!wal) return;
+        redo += (char)op;
+        appendString(key);
+        if (op == PUT) appendString(value);
+    }
+
+    // Applies one logged transaction during recovery; false if it does not parse
+    bool replay(const char* data, size_t size) {
+        size_t position = 0;
+        auto readString = [&](string& out) {
+            uint32_t length;
+            if (size - position < sizeof(length)) return false;
+            memcpy(&length, data + position, sizeof(length));
+            position += sizeof(length);
+            if (size - position < length) return false;
+            out.assign(data + position, length);
+            position += length;
+            return true;
+        };
+        string key, value;
+        while (position < size) {
+            uint8_t op = data[position++];
+            if (!readString(key)) return false;
+            if (op == PUT) {
+                if (!readString(value)) return false;
+                records->put(key, value, nullptr);
+            } else if (op == ERASE) {
+                records->erase(key, nullptr);
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
     
 public:
+    explicit Database(StorageEngineType engine = StorageEngineType::ORDERED)
+        : records(StorageEngine::create(engine)) {}
+
+    void setOutput(ostream* output) {
+        this->output = output;
+    }
+
     // Insert a record
     void insert(const string& key, const string& value) {
-        records[key] = value;
-        cout << "Inserted: " << key << " = " << value << endl;
+        string prior;
+        bool existed = records->put(key, value, logging ? &prior : nullptr);
+        logPrior(key, existed, prior);
+        logRedo(PUT, key, value);
+        *output << "Inserted: " << key << " = " << value << endl;
     }
     
     // Update a record
     void update(const string& key, const string& value) {
-        if (records.find(key) != records.end()) {
-            records[key] = value;
-            cout << "Updated: " << key << " = " << value << endl;
+        string prior;
+        if (records->replace(key, value, logging ? &prior : nullptr)) {
+            logPrior(key, true, prior);
+            logRedo(PUT, key, value);
+            *output << "Updated: " << key << " = " << value << endl;
         } else {
-            cout << "Key not found for update: " << key << endl;
+            *output << "Key not found for update: " << key << endl;
         }
     }
     
     // Delete a record
     void remove(const string& key) {
-        auto it = records.find(key);
-        if (it != records.end()) {
-            records.erase(it);
-            cout << "Deleted: " << key << endl;
+        string prior;
+        if (records->erase(key, logging ? &prior : nullptr)) {
+            logPrior(key, true, prior);
+            logRedo(ERASE, key);
+            *output << "Deleted: " << key << endl;
         } else {
-            cout << "Key not found for deletion: " << key << endl;
+            *output << "Key not found for deletion: " << key << endl;
         }
     }
+
+    // False if there is no such record
+    bool get(const string& key, string& value) const {
+        string_view found;
+        if (!records->find(key, found)) return false;
+        value.assign(found);
+        return true;
+    }
+
+    size_t size() const {
+        return records->size();
+    }
     
+    // Undo log - from here on every write records the prior value of its key
+    void startUndoLog() {
+        logging = true;
+        undoLog.clear();
+    }
+
+    // Position in the undo log that undoTo() can return to
+    size_t undoMark() const {
+        return undoLog.size();
+    }
+
+    // Undoes the writes logged after `mark`, newest first, and drops them from the
+    // uncommitted log output too
+    void undoTo(size_t mark) {
+        size_t redoEnd = redo.size();
+        while (undoLog.size() > mark) {
+            UndoRecord& record = undoLog.back();
+            redoEnd = record.redoBytes;
+            if (record.existed) {
+                records->put(record.key, record.value, nullptr);
+            } else {
+                records->erase(record.key, nullptr);
+            }
+            undoLog.pop_back();
+        }
+        redo.resize(redoEnd);
+    }
+
+    // Keeps the writes and drops the log
+    void stopUndoLog() {
+        logging = false;
+        undoLog.clear();
+    }
+
+    // Durability - replays the committed transactions in `log` into the records, then
+    // keeps logging to it. Writes become durable when commit() returns.
+    void attachLog(WriteAheadLog* log) {
+        uint64_t transactions = log->recover([this](const char* data, size_t size) {
+            if (!replay(data, size)) {
+                throw runtime_error("log frame does not parse");
+            }
+        });
+        *output << "Recovered " << transactions << " transactions from the log" << endl;
+        wal = log;
+        redo.clear();
+    }
+
+    // Writes everything since the last commit to the log as one transaction
+    void commit() {
+        if (wal && !redo.empty()) {
+            wal->commit(redo);
+        }
+        redo.clear();
+    }
+
     // Create memento - Save current state
     DatabaseMemento* createMemento() {
-        cout << "Creating database backup..." << endl;
-        return new DatabaseMemento(records);
+        *output << "Creating database backup..." << endl;
+        return new DatabaseMemento(records->clone(), redo.size());
     }
     
     // Restore from memento - Rollback to saved state
     void restoreFromMemento(const DatabaseMemento& memento) {
-        records = memento.getState();
-        cout << "Database restored from backup!" << endl;
+        records = memento.getState().clone();
+        redo.resize(min(redo.size(), memento.getRedoBytes()));
+        *output << "Database restored from backup!" << endl;
     }
     
     // Display current database state
     void displayRecords() {
         cout << "\n--- Current Database State ---" << endl;
-        if (records.empty()) {
+        if (records->size() == 0) {
             cout << "Database is empty" << endl;
         } else {
-            for (const auto& record : records) {
-                cout << record.first << " = " << record.second << endl;
+            vector<pair<string, string>> rows;
+            records->forEach([&](const string& key, string_view value) {
+                rows.push_back({key, string(value)});
+            });
+            if (!records->isOrdered()) {
+                sort(rows.begin(), rows.end());
+            }
+            for (const auto& row : rows) {
+                cout << row.first << " = " << row.second << endl;
             }
         }
         cout << "-----------------------------\n" << endl;
@@ -83,9 +840,10 @@ public:
 class TransactionManager {
 private:
     DatabaseMemento* backup;
+    Database* db; // database of the open transaction
     
 public:
-    TransactionManager() : backup(nullptr) {}
+    TransactionManager() : backup(nullptr), db(nullptr) {}
     
     // Destructor to clean up memory
     ~TransactionManager() {
@@ -101,11 +859,16 @@ public:
             delete backup; // Clean up previous backup
         }
         backup = db.createMemento();
+        this->db = &db;
     }
     
     // Commit transaction - discard backup
     void commitTransaction() {
         cout << "=== COMMIT TRANSACTION ===" << endl;
+        if (db) {
+            db->commit();
+            db = nullptr;
+        }
         if (backup) {
             delete backup;
             backup = nullptr;
@@ -120,6 +883,7 @@ public:
             db.restoreFromMemento(*backup);
             delete backup;
             backup = nullptr;
+            this->db = nullptr;
             cout << "Transaction rolled back!" << endl;
         } 
         else {
@@ -128,7 +892,934 @@ public:
     }
 };
 
-int main() {
+// Caretaker - Transactions over the database's undo log instead of mementos.
+// Begin is O(1), rollback is O(writes made) and commit just drops the log.
+// Savepoints nest: rolling back to one undoes the writes made since it and keeps it
+// (and the savepoints before it) open, like SQL's ROLLBACK TO SAVEPOINT.
+class UndoLogTransactionManager {
+private:
+    vector<pair<string, size_t>> savepoints; // name and undo log mark, oldest first
+    bool active = false;
+
+    // Index of the newest savepoint with this name, -1 if there is none
+    int findSavepoint(const string& name) const {
+        for (int i = savepoints.size() - 1; i >= 0; i--) {
+            if (savepoints[i].first == name) return i;
+        }
+        return -1;
+    }
+
+public:
+    void beginTransaction(Database& db) {
+        cout << "=== BEGIN TRANSACTION (undo log) ===" << endl;
+        savepoints.clear();
+        db.startUndoLog();
+        active = true;
+    }
+
+    void savepoint(Database& db, const string& name) {
+        if (!active) {
+            cout << "No transaction for savepoint " << name << endl;
+            return;
+        }
+        savepoints.push_back({name, db.undoMark()});
+        cout << "Savepoint " << name << " created" << endl;
+    }
+
+    void rollbackToSavepoint(Database& db, const string& name) {
+        int index = findSavepoint(name);
+        if (index < 0) {
+            cout << "No such savepoint: " << name << endl;
+            return;
+        }
+        db.undoTo(savepoints[index].second);
+        savepoints.resize(index + 1);
+        cout << "Rolled back to savepoint " << name << endl;
+    }
+
+    // Forgets the savepoint (and the ones after it) but keeps their writes
+    void releaseSavepoint(const string& name) {
+        int index = findSavepoint(name);
+        if (index < 0) {
+            cout << "No such savepoint: " << name << endl;
+            return;
+        }
+        savepoints.resize(index);
+        cout << "Savepoint " << name << " released" << endl;
+    }
+
+    void commitTransaction(Database& db) {
+        cout << "=== COMMIT TRANSACTION ===" << endl;
+        db.commit();
+        db.stopUndoLog();
+        savepoints.clear();
+        active = false;
+        cout << "Transaction committed successfully!" << endl;
+    }
+
+    void rollbackTransaction(Database& db) {
+        cout << "=== ROLLBACK TRANSACTION ===" << endl;
+        if (!active) {
+            cout << "No transaction to roll back!" << endl;
+            return;
+        }
+        db.undoTo(0);
+        db.stopUndoLog();
+        savepoints.clear();
+        active = false;
+        cout << "Transaction rolled back!" << endl;
+    }
+};
+
+// Multi-version store with snapshot isolation, for many threads at once.
+// Every key has a chain of versions, newest first, each stamped with the commit
+// timestamp of the transaction that wrote it. A transaction reads as of the timestamp
+// it started at (its snapshot), so readers never wait for writers or each other.
+// Writes are buffered in the transaction and applied at commit under one mutex; a
+// transaction whose key was committed by someone else after its snapshot is aborted
+// (first committer wins).
+// Versions no snapshot can see any more are trimmed by a background thread: the oldest
+// open snapshot is the horizon, and everything behind the version visible at the
+// horizon is freed. A deletion visible at the horizon with nothing older is dropped
+// as well; its chain stays in the index, empty, and is reused if the key comes back.
+class VersionedDatabase {
+private:
+    static const int MAX_SNAPSHOTS = 256; // transactions open at once
+    static const uint64_t IDLE = UINT64_MAX;
+
+    struct Version {
+        uint64_t commitTs;
+        bool deleted;
+        string value;
+        atomic<Version*> older;
+    };
+
+    struct VersionChain {
+        const string key;
+        atomic<Version*> newest{nullptr};
+    };
+
+    // Open transactions publish their snapshot here for the garbage collector
+    struct alignas(64) SnapshotSlot {
+        atomic<uint64_t> snapshot{IDLE};
+        atomic<bool> taken{false};
+    };
+
+    // Open-addressing key index. Lookups take no lock; only committers insert (under
+    // commitMutex), and growing publishes a new table. Outgrown tables hold nothing but
+    // pointers and are kept until the database is destroyed, so a reader still probing
+    // one is never left with freed memory.
+    struct Index {
+        size_t mask;
+        unique_ptr<atomic<VersionChain*>[]> slots;
+        explicit Index(size_t capacity) : mask(capacity - 1), slots(new atomic<VersionChain*>[capacity]) {
+            for (size_t i = 0; i <= mask; i++) {
+                slots[i].store(nullptr, memory_order_relaxed);
+            }
+        }
+    };
+
+    atomic<uint64_t> clock{0};           // timestamp of the newest commit
+    SnapshotSlot snapshots[MAX_SNAPSHOTS];
+    atomic<Index*> index;
+    vector<unique_ptr<Index>> indexes;   // every table ever used, current one last
+    size_t chainCount = 0;
+
+    mutex commitMutex;
+    mutex collectMutex;  // one collection pass at a time
+    mutex trimMutex;
+    vector<pair<uint64_t, VersionChain*>> toTrim; // commit timestamp of a version with older ones behind it, or a deletion
+    vector<pair<uint64_t, Version*>> unlinked;    // dropped deletions and the clock when they were unlinked (collectMutex)
+
+    thread collector;
+    mutex collectorMutex;
+    condition_variable collectorWake;
+    bool stopping = false;
+    atomic<uint64_t> versionsFreed{0};
+
+    VersionChain* findChain(const string& key) const {
+        Index* table = index.load(memory_order_acquire);
+        for (size_t i = hash<string>()(key);; i++) {
+            VersionChain* chain = table->slots[i & table->mask].load(memory_order_acquire);
+            if (!chain || chain->key == key) return chain;
+        }
+    }
+
+    // commitMutex held
+    void placeChain(Index& table, VersionChain* chain) {
+        for (size_t i = hash<string>()(chain->key);; i++) {
+            if (!table.slots[i & table.mask].load(memory_order_relaxed)) {
+                table.slots[i & table.mask].store(chain, memory_order_release);
+                return;
+            }
+        }
+    }
+
+    // commitMutex held
+    VersionChain* addChain(const string& key) {
+        Index* table = index.load(memory_order_relaxed);
+        if ((chainCount + 1) * 10 > (table->mask + 1) * 7) {
+            indexes.emplace_back(new Index((table->mask + 1) * 2));
+            for (size_t i = 0; i <= table->mask; i++) {
+                if (VersionChain* chain = table->slots[i].load(memory_order_relaxed)) {
+                    placeChain(*indexes.back(), chain);
+                }
+            }
+            table = indexes.back().get();
+            index.store(table, memory_order_release);
+        }
+        VersionChain* chain = new VersionChain{key};
+        placeChain(*table, chain);
+        chainCount++;
+        return chain;
+    }
+
+    // Claims a slot and publishes a snapshot in it. The clock is read again after
+    // publishing: if it has not moved, any collector that missed the slot computed its
+    // horizon from a clock no newer than this snapshot.
+    SnapshotSlot* openSnapshot(uint64_t& snapshot) {
+        size_t start = hash<thread::id>()(this_thread::get_id());
+        for (size_t i = start;; i++) {
+            SnapshotSlot& slot = snapshots[i % MAX_SNAPSHOTS];
+            bool expected = false;
+            if (!slot.taken.load(memory_order_relaxed) && slot.taken.compare_exchange_strong(expected, true)) {
+                do {
+                    snapshot = clock.load();
+                    slot.snapshot.store(snapshot);
+                } while (clock.load() != snapshot);
+                return &slot;
+            }
+            if ((i - start) % MAX_SNAPSHOTS == MAX_SNAPSHOTS - 1) {
+                this_thread::yield(); // all slots busy, wait for a transaction to end
+            }
+        }
+    }
+
+    static void closeSnapshot(SnapshotSlot* slot) {
+        slot->snapshot.store(IDLE, memory_order_release);
+        slot->taken.store(false, memory_order_release);
+    }
+
+    // Newest version visible at `snapshot`, nullptr if the key did not exist then
+    static const Version* visible(const VersionChain* chain, uint64_t snapshot) {
+        const Version* version = chain ? chain->newest.load(memory_order_acquire) : nullptr;
+        while (version && version->commitTs > snapshot) {
+            version = version->older.load(memory_order_acquire);
+        }
+        return version && !version->deleted ? version : nullptr;
+    }
+
+    static void freeVersions(Version* version, uint64_t& freed) {
+        while (version) {
+            Version* older = version->older.load(memory_order_relaxed);
+            delete version;
+            version = older;
+            freed++;
+        }
+    }
+
+    // One garbage collection pass; returns the versions freed
+    uint64_t collectGarbage() {
+        lock_guard<mutex> collecting(collectMutex);
+        uint64_t horizon = clock.load();
+        for (SnapshotSlot& slot : snapshots) {
+            horizon = min(horizon, slot.snapshot.load());
+        }
+        vector<pair<uint64_t, VersionChain*>> work;
+        {
+            lock_guard<mutex> lock(trimMutex);
+            work.swap(toTrim);
+        }
+        uint64_t freed = 0;
+        // A reader may still hold a deletion it loaded before it was unlinked, but only
+        // one whose snapshot was no newer than the clock at that point
+        size_t pending = 0;
+        for (auto& item : unlinked) {
+            if (item.first < horizon) {
+                delete item.second;
+                freed++;
+            } else {
+                unlinked[pending++] = item;
+            }
+        }
+        unlinked.resize(pending);
+        vector<pair<uint64_t, VersionChain*>> later;
+        for (auto& item : work) {
+            if (item.first > horizon) {
+                later.push_back(item);
+                continue;
+            }
+            // Snapshots at or after the horizon stop at `keep` or before it
+            VersionChain* chain = item.second;
+            Version* newer = nullptr;
+            Version* keep = chain->newest.load(memory_order_acquire);
+            while (keep && keep->commitTs > horizon) {
+                newer = keep;
+                keep = keep->older.load(memory_order_acquire);
+            }
+            if (!keep) continue; // already dropped by an earlier item for this key
+            freeVersions(keep->older.exchange(nullptr), freed);
+            if (!keep->deleted) continue;
+            // Those snapshots find no value either way, so the deletion can go too
+            if (newer) {
+                newer->older.store(nullptr, memory_order_release);
+            } else {
+                lock_guard<mutex> lock(commitMutex);
+                if (chain->newest.load(memory_order_relaxed) != keep) continue; // written meanwhile
+                chain->newest.store(nullptr, memory_order_release);
+            }
+            unlinked.push_back({clock.load(), keep});
+        }
+        if (!later.empty()) {
+            lock_guard<mutex> lock(trimMutex);
+            toTrim.insert(toTrim.end(), later.begin(), later.end());
+        }
+        versionsFreed.fetch_add(freed, memory_order_relaxed);
+        return freed;
+    }
+
+    void runCollector(chrono::milliseconds interval) {
+        unique_lock<mutex> lock(collectorMutex);
+        while (!stopping) {
+            collectorWake.wait_for(lock, interval);
+            lock.unlock();
+            collectGarbage();
+            lock.lock();
+        }
+    }
+
+public:
+    class Transaction {
+    private:
+        VersionedDatabase* db;
+        SnapshotSlot* slot;
+        uint64_t snapshot;
+        map<string, pair<bool, string>> writes; // key -> (deleted, value)
+
+        void close() {
+            if (slot) {
+                closeSnapshot(slot);
+                slot = nullptr;
+            }
+        }
+
+    public:
+        explicit Transaction(VersionedDatabase& db) : db(&db) {
+            slot = db.openSnapshot(snapshot);
+        }
+
+        ~Transaction() {
+            close();
+        }
+
+        Transaction(const Transaction&) = delete;
+        Transaction& operator=(const Transaction&) = delete;
+
+        uint64_t getSnapshot() const {
+            return snapshot;
+        }
+
+        // Sees this transaction's own writes, then the snapshot
+        bool get(const string& key, string& value) const {
+            auto own = writes.find(key);
+            if (own != writes.end()) {
+                if (own->second.first) return false;
+                value = own->second.second;
+                return true;
+            }
+            const Version* version = visible(db->findChain(key), snapshot);
+            if (!version) return false;
+            value = version->value;
+            return true;
+        }
+
+        void put(const string& key, const string& value) {
+            writes[key] = {false, value};
+        }
+
+        void remove(const string& key) {
+            writes[key] = {true, string()};
+        }
+
+        // Visits the records visible to this transaction in key order
+        template <typename Visitor>
+        void forEach(Visitor visit) const {
+            map<string, string> rows;
+            Index* table = db->index.load(memory_order_acquire);
+            for (size_t i = 0; i <= table->mask; i++) {
+                VersionChain* chain = table->slots[i].load(memory_order_acquire);
+                if (!chain) continue;
+                if (const Version* version = visible(chain, snapshot)) {
+                    rows[chain->key] = version->value;
+                }
+            }
+            for (auto& write : writes) {
+                if (write.second.first) {
+                    rows.erase(write.first);
+                } else {
+                    rows[write.first] = write.second.second;
+                }
+            }
+            for (auto& row : rows) {
+                visit(row.first, row.second);
+            }
+        }
+
+        // False if another transaction committed one of our keys after our snapshot;
+        // the transaction is over either way
+        bool commit() {
+            if (!slot) return false;
+            bool committed = writes.empty() || db->apply(snapshot, writes);
+            writes.clear();
+            close();
+            return committed;
+        }
+
+        void abort() {
+            writes.clear();
+            close();
+        }
+    };
+
+private:
+    bool apply(uint64_t snapshot, const map<string, pair<bool, string>>& writes) {
+        lock_guard<mutex> lock(commitMutex);
+        for (auto& write : writes) {
+            VersionChain* chain = findChain(write.first);
+            Version* newest = chain ? chain->newest.load(memory_order_relaxed) : nullptr;
+            if (newest && newest->commitTs > snapshot) return false;
+        }
+        uint64_t commitTs = clock.load() + 1;
+        vector<pair<uint64_t, VersionChain*>> trims;
+        for (auto& write : writes) {
+            VersionChain* chain = findChain(write.first);
+            if (!chain) chain = addChain(write.first);
+            Version* older = chain->newest.load(memory_order_relaxed);
+            Version* version = new Version{commitTs, write.second.first, write.second.second, {older}};
+            chain->newest.store(version, memory_order_release);
+            if (older || version->deleted) trims.push_back({commitTs, chain});
+        }
+        // Readers only look at versions up to the clock, so this makes the commit visible
+        clock.store(commitTs);
+        if (!trims.empty()) {
+            lock_guard<mutex> trimLock(trimMutex);
+            toTrim.insert(toTrim.end(), trims.begin(), trims.end());
+        }
+        return true;
+    }
+
+public:
+    explicit VersionedDatabase(chrono::milliseconds gcInterval = chrono::milliseconds(5)) {
+        indexes.emplace_back(new Index(1024));
+        index.store(indexes.back().get());
+        collector = thread([this, gcInterval] { runCollector(gcInterval); });
+    }
+
+    ~VersionedDatabase() {
+        {
+            lock_guard<mutex> lock(collectorMutex);
+            stopping = true;
+        }
+        collectorWake.notify_all();
+        collector.join();
+        uint64_t freed = 0;
+        Index* table = index.load();
+        for (size_t i = 0; i <= table->mask; i++) {
+            if (VersionChain* chain = table->slots[i].load()) {
+                freeVersions(chain->newest.load(), freed);
+                delete chain;
+            }
+        }
+        for (auto& item : unlinked) {
+            delete item.second;
+        }
+    }
+
+    VersionedDatabase(const VersionedDatabase&) = delete;
+    VersionedDatabase& operator=(const VersionedDatabase&) = delete;
+
+    uint64_t getCommitTimestamp() const {
+        return clock.load();
+    }
+
+    uint64_t getVersionsFreed() const {
+        return versionsFreed.load(memory_order_relaxed);
+    }
+
+    // Runs a collection pass now instead of waiting for the background thread
+    uint64_t collect() {
+        return collectGarbage();
+    }
+};
+
+// Begin/rollback latency against record count: the persistent map next to the
+// std::map copies the memento used to make (one copy to begin, two to roll back)
+void benchmarkMementos() {
+    const int writesPerTransaction = 10;
+    cout << setw(10) << "records" << setw(16) << "begin (us)" << setw(16) << "rollback (us)"
+         << setw(20) << "map begin (us)" << setw(22) << "map rollback (us)" << endl;
+    for (int recordCount : {1000, 10000, 100000, 1000000}) {
+        ostream quiet(nullptr);
+        Database db;
+        db.setOutput(&quiet);
+        map<string, string> copied;
+        for (int i = 0; i < recordCount; i++) {
+            string key = "user" + to_string(i);
+            db.insert(key, "value" + to_string(i));
+            copied[key] = "value" + to_string(i);
+        }
+        int transactions = max(3, 100000 / recordCount);
+
+        double beginUs = 0, rollbackUs = 0;
+        bool intact = true;
+        for (int t = 0; t < transactions; t++) {
+            auto start = chrono::steady_clock::now();
+            DatabaseMemento* backup = db.createMemento();
+            beginUs += chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+            for (int w = 0; w < writesPerTransaction; w++) {
+                db.update("user" + to_string((t * 7919 + w * 104729) % recordCount), "changed");
+            }
+            start = chrono::steady_clock::now();
+            db.restoreFromMemento(*backup);
+            rollbackUs += chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+            delete backup;
+            string value;
+            db.get("user" + to_string(t * 7919 % recordCount), value);
+            intact = intact && value != "changed";
+        }
+
+        double mapBeginUs = 0, mapRollbackUs = 0;
+        for (int t = 0; t < transactions; t++) {
+            auto start = chrono::steady_clock::now();
+            map<string, string>* backup = new map<string, string>(copied);
+            mapBeginUs += chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+            for (int w = 0; w < writesPerTransaction; w++) {
+                copied["user" + to_string((t * 7919 + w * 104729) % recordCount)] = "changed";
+            }
+            start = chrono::steady_clock::now();
+            map<string, string> state = *backup;
+            copied = state;
+            mapRollbackUs += chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+            delete backup;
+        }
+
+        cout << fixed << setprecision(2) << setw(10) << recordCount << setw(16) << beginUs / transactions
+             << setw(16) << rollbackUs / transactions << setw(20) << mapBeginUs / transactions
+             << setw(22) << mapRollbackUs / transactions << (intact && db.size() == (size_t)recordCount ? "" : "  ROLLBACK LOST DATA")
+             << endl;
+    }
+}
+
+// A batch job of steps that each write some records under a savepoint; every fourth
+// step fails and is rolled back to its savepoint, the rest are released
+void benchmarkUndoLog() {
+    const int steps = 20000;
+    const int writesPerStep = 8;
+    cout << setw(10) << "records" << setw(18) << "begin (us)" << setw(22) << "step rollback (us)"
+         << setw(18) << "commit (us)" << endl;
+    for (int recordCount : {1000, 100000, 1000000}) {
+        ostream quiet(nullptr);
+        streambuf* console = cout.rdbuf(nullptr); // the manager reports to cout
+        Database db;
+        db.setOutput(&quiet);
+        for (int i = 0; i < recordCount; i++) {
+            db.insert("user" + to_string(i), "value" + to_string(i));
+        }
+        UndoLogTransactionManager txManager;
+
+        auto start = chrono::steady_clock::now();
+        txManager.beginTransaction(db);
+        double beginUs = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+
+        double rollbackUs = 0;
+        int rollbacks = 0;
+        bool intact = true;
+        for (int step = 0; step < steps; step++) {
+            txManager.savepoint(db, "step");
+            for (int w = 0; w < writesPerStep; w++) {
+                string key = "user" + to_string((step * 7919 + w * 104729) % recordCount);
+                if (step % 4 == 3) {
+                    db.update(key, "failed");
+                } else {
+                    db.insert(key, "step" + to_string(step));
+                }
+            }
+            if (step % 4 == 3) {
+                auto rollbackStart = chrono::steady_clock::now();
+                txManager.rollbackToSavepoint(db, "step");
+                rollbackUs += chrono::duration<double, micro>(chrono::steady_clock::now() - rollbackStart).count();
+                rollbacks++;
+                string value;
+                db.get("user" + to_string(step * 7919 % recordCount), value);
+                intact = intact && value != "failed";
+            }
+            txManager.releaseSavepoint("step");
+        }
+
+        start = chrono::steady_clock::now();
+        txManager.commitTransaction(db);
+        double commitUs = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+        cout.rdbuf(console);
+
+        cout << fixed << setprecision(2) << setw(10) << recordCount << setw(18) << beginUs << setw(22)
+             << rollbackUs / rollbacks << setw(18) << commitUs << (intact ? "" : "  ROLLBACK LOST DATA") << endl;
+    }
+}
+
+// Committed transactions per second against the group commit window. Committers run
+// on their own databases (shards of disjoint keys) over one shared log; afterwards the
+// log is recovered into a fresh database to check every committed write is there.
+void benchmarkGroupCommit() {
+    const string path = "/tmp/memento_bench_wal";
+    const int threadCount = 8;
+    const int writesPerTransaction = 4;
+    const chrono::milliseconds duration(1000);
+    cout << setw(12) << "window (us)" << setw(14) << "commits/s" << setw(10) << "syncs"
+         << setw(16) << "commits/sync" << setw(16) << "recovered" << endl;
+    for (int windowUs : {0, 50, 200, 1000, 5000}) {
+        unlink(path.c_str());
+        uint64_t commits = 0, syncs = 0;
+        double seconds = 0;
+        ostream quiet(nullptr);
+        {
+            WriteAheadLog log(path, chrono::microseconds(windowUs));
+            vector<Database> shards(threadCount);
+            for (Database& shard : shards) {
+                shard.setOutput(&quiet);
+                shard.attachLog(&log);
+            }
+            atomic<uint64_t> committed(0);
+            atomic<bool> stop(false);
+            vector<thread> threads;
+            auto start = chrono::steady_clock::now();
+            for (int t = 0; t < threadCount; t++) {
+                threads.emplace_back([&, t] {
+                    Database& db = shards[t];
+                    for (uint64_t n = 0; !stop.load(memory_order_relaxed); n++) {
+                        for (int w = 0; w < writesPerTransaction; w++) {
+                            db.insert("t" + to_string(t) + "-" + to_string(n) + "-" + to_string(w), "value");
+                        }
+                        db.commit();
+                        committed.fetch_add(1, memory_order_relaxed);
+                    }
+                });
+            }
+            this_thread::sleep_for(duration);
+            stop = true;
+            for (thread& worker : threads) {
+                worker.join();
+            }
+            seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            commits = committed.load();
+            syncs = log.getSyncCount();
+        }
+
+        Database recovered;
+        recovered.setOutput(&quiet);
+        WriteAheadLog log(path);
+        recovered.attachLog(&log);
+        bool complete = recovered.size() == commits * writesPerTransaction;
+
+        cout << fixed << setprecision(1) << setw(12) << windowUs << setw(14) << commits / seconds
+             << setw(10) << syncs << setw(16) << (double)commits / max<uint64_t>(syncs, 1)
+             << setw(16) << (complete ? "all" : "MISSING") << endl;
+    }
+    unlink(path.c_str());
+}
+
+// Read throughput with writers running. Writers move money between accounts; readers
+// read a few accounts per transaction, and every 64th reader transaction audits all of
+// them, which only adds up if its snapshot is consistent. The same workload against a
+// std::map behind one mutex is shown for comparison.
+void benchmarkSnapshotIsolation() {
+    const int accountCount = 1000;
+    const int initialBalance = 1000;
+    const int writerCount = 2;
+    const int readsPerTransaction = 8;
+    const chrono::milliseconds duration(500);
+    vector<string> keys;
+    for (int i = 0; i < accountCount; i++) {
+        keys.push_back("acct" + to_string(i));
+    }
+    const long long total = (long long)accountCount * initialBalance;
+
+    struct Result {
+        double readsPerSecond;
+        double commitsPerSecond;
+        uint64_t aborts;
+        uint64_t audits;
+        bool consistent;
+    };
+
+    // Runs `readers` reader threads and the writers against one store for `duration`
+    auto measure = [&](int readers, auto readTransaction, auto writeTransaction) {
+        atomic<bool> stop(false);
+        atomic<uint64_t> reads(0), commits(0), aborts(0), audits(0);
+        atomic<bool> consistent(true);
+        vector<thread> threads;
+        auto start = chrono::steady_clock::now();
+        for (int w = 0; w < writerCount; w++) {
+            threads.emplace_back([&, w] {
+                mt19937 rng(100 + w);
+                uint64_t done = 0, failed = 0;
+                while (!stop.load(memory_order_relaxed)) {
+                    int from = rng() % accountCount, to = rng() % accountCount;
+                    if (from == to) continue;
+                    (writeTransaction(keys[from], keys[to]) ? done : failed)++;
+                }
+                commits += done;
+                aborts += failed;
+            });
+        }
+        for (int r = 0; r < readers; r++) {
+            threads.emplace_back([&, r] {
+                mt19937 rng(r);
+                uint64_t done = 0, audited = 0;
+                bool ok = true;
+                while (!stop.load(memory_order_relaxed)) {
+                    bool audit = done % 64 == 0;
+                    long long sum = readTransaction(rng, audit);
+                    ok = ok && (!audit || sum == total);
+                    audited += audit;
+                    done += audit ? accountCount : readsPerTransaction;
+                }
+                reads += done;
+                audits += audited;
+                if (!ok) consistent = false;
+            });
+        }
+        this_thread::sleep_for(duration);
+        stop = true;
+        for (thread& worker : threads) {
+            worker.join();
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return Result{reads / seconds, commits / seconds, aborts.load(), audits.load(), consistent.load()};
+    };
+
+    unsigned cores = max(1u, thread::hardware_concurrency());
+    vector<int> readerCounts = {1, 2, 4};
+    if (cores > 4) readerCounts.push_back(cores);
+    cout << cores << " hardware threads, " << writerCount << " writer threads, " << accountCount << " accounts" << endl;
+    cout << setw(8) << "readers" << setw(16) << "MVCC reads/s" << setw(16) << "writes/s" << setw(9) << "aborts"
+         << setw(9) << "audits" << setw(18) << "mutex reads/s" << setw(16) << "writes/s" << endl;
+    for (int readers : readerCounts) {
+        VersionedDatabase db;
+        {
+            VersionedDatabase::Transaction setup(db);
+            for (const string& key : keys) {
+                setup.put(key, to_string(initialBalance));
+            }
+            setup.commit();
+        }
+        Result mvcc = measure(
+            readers,
+            [&](mt19937& rng, bool audit) {
+                VersionedDatabase::Transaction transaction(db);
+                string value;
+                long long sum = 0;
+                for (int i = 0; i < (audit ? accountCount : readsPerTransaction); i++) {
+                    transaction.get(keys[audit ? i : rng() % accountCount], value);
+                    sum += stoll(value);
+                }
+                return sum;
+            },
+            [&](const string& from, const string& to) {
+                VersionedDatabase::Transaction transaction(db);
+                string a, b;
+                transaction.get(from, a);
+                transaction.get(to, b);
+                transaction.put(from, to_string(stoll(a) - 1));
+                transaction.put(to, to_string(stoll(b) + 1));
+                return transaction.commit();
+            });
+        uint64_t freed = db.getVersionsFreed();
+
+        map<string, string> table;
+        mutex tableMutex;
+        for (const string& key : keys) {
+            table[key] = to_string(initialBalance);
+        }
+        Result locked = measure(
+            readers,
+            [&](mt19937& rng, bool audit) {
+                lock_guard<mutex> lock(tableMutex);
+                long long sum = 0;
+                for (int i = 0; i < (audit ? accountCount : readsPerTransaction); i++) {
+                    sum += stoll(table.find(keys[audit ? i : rng() % accountCount])->second);
+                }
+                return sum;
+            },
+            [&](const string& from, const string& to) {
+                lock_guard<mutex> lock(tableMutex);
+                string& a = table[from];
+                string& b = table[to];
+                a = to_string(stoll(a) - 1);
+                b = to_string(stoll(b) + 1);
+                return true;
+            });
+
+        cout << fixed << setprecision(0) << setw(8) << readers << setw(16) << mvcc.readsPerSecond
+             << setw(16) << mvcc.commitsPerSecond << setw(9) << mvcc.aborts << setw(9) << mvcc.audits
+             << setw(18) << locked.readsPerSecond << setw(16) << locked.commitsPerSecond
+             << (mvcc.consistent && locked.consistent ? "" : "  INCONSISTENT SNAPSHOT")
+             << "  (" << freed << " old versions collected)" << endl;
+    }
+}
+
+// Point-operation throughput of each storage engine next to the std::map the database
+// used to keep (with its find-then-operator[] update), followed by a randomized
+// cross-check of both engines against std::map with long keys and growing values
+void benchmarkStorageEngines() {
+    const int keyCount = 1000000;
+    vector<string> keys, values;
+    for (int i = 0; i < keyCount; i++) {
+        keys.push_back("user" + to_string(i));
+        values.push_back("value" + to_string(i));
+    }
+    vector<int> order(keyCount);
+    for (int i = 0; i < keyCount; i++) {
+        order[i] = i;
+    }
+    shuffle(order.begin(), order.end(), mt19937(3));
+
+    auto timeMops = [&](auto run) {
+        auto start = chrono::steady_clock::now();
+        run();
+        return keyCount / chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+    };
+    cout << keyCount << " keys, million operations per second" << endl;
+    cout << setw(10) << "" << setw(10) << "insert" << setw(10) << "get" << setw(10) << "update"
+         << setw(10) << "remove" << endl;
+    cout << fixed << setprecision(2);
+
+    {
+        map<string, string> records;
+        size_t found = 0;
+        double insert = timeMops([&] {
+            for (int i : order) records[keys[i]] = values[i];
+        });
+        double get = timeMops([&] {
+            for (int i = keyCount; i-- > 0; ) found += records.find(keys[order[i]]) != records.end();
+        });
+        double update = timeMops([&] {
+            for (int i : order) {
+                if (records.find(keys[i]) != records.end()) records[keys[i]] = values[keyCount - 1 - i];
+            }
+        });
+        double remove = timeMops([&] {
+            for (int i : order) records.erase(keys[i]);
+        });
+        cout << setw(10) << "std::map" << setw(10) << insert << setw(10) << get << setw(10) << update
+             << setw(10) << remove << (found == keyCount ? "" : "  LOST KEYS") << endl;
+    }
+    for (StorageEngineType type : {StorageEngineType::ORDERED, StorageEngineType::HASH}) {
+        unique_ptr<StorageEngine> engine = StorageEngine::create(type);
+        size_t found = 0;
+        string_view value;
+        double insert = timeMops([&] {
+            for (int i : order) engine->put(keys[i], values[i], nullptr);
+        });
+        double get = timeMops([&] {
+            for (int i = keyCount; i-- > 0; ) found += engine->find(keys[order[i]], value);
+        });
+        double update = timeMops([&] {
+            for (int i : order) engine->replace(keys[i], values[keyCount - 1 - i], nullptr);
+        });
+        double remove = timeMops([&] {
+            for (int i : order) engine->erase(keys[i], nullptr);
+        });
+        cout << setw(10) << (type == StorageEngineType::HASH ? "hash" : "ordered") << setw(10) << insert
+             << setw(10) << get << setw(10) << update << setw(10) << remove
+             << (found == keyCount && engine->size() == 0 ? "" : "  LOST KEYS") << endl;
+    }
+
+    const int checks = 300000;
+    bool same = true;
+    for (StorageEngineType type : {StorageEngineType::ORDERED, StorageEngineType::HASH}) {
+        unique_ptr<StorageEngine> engine = StorageEngine::create(type);
+        map<string, string> expected;
+        mt19937 rng(9);
+        string prior;
+        string_view value;
+        for (int n = 0; n < checks && same; n++) {
+            int id = rng() % 5000;
+            string key = id % 3 == 0 ? "a-much-longer-key-that-does-not-fit-inline-" + to_string(id) : "k" + to_string(id);
+            string text(rng() % 40, (char)('a' + n % 26));
+            auto it = expected.find(key);
+            switch (rng() % 4) {
+                case 0:
+                    same = engine->put(key, text, &prior) == (it != expected.end()) &&
+                           (it == expected.end() || prior == it->second);
+                    expected[key] = text;
+                    break;
+                case 1:
+                    same = engine->replace(key, text, &prior) == (it != expected.end()) &&
+                           (it == expected.end() || prior == it->second);
+                    if (it != expected.end()) it->second = text;
+                    break;
+                case 2:
+                    same = engine->erase(key, &prior) == (it != expected.end()) &&
+                           (it == expected.end() || prior == it->second);
+                    if (it != expected.end()) expected.erase(it);
+                    break;
+                default:
+                    same = engine->find(key, value) == (it != expected.end()) &&
+                           (it == expected.end() || value == it->second);
+            }
+        }
+        size_t visited = 0;
+        engine->forEach([&](const string& key, string_view value) {
+            auto it = expected.find(key);
+            same = same && it != expected.end() && value == it->second;
+            visited++;
+        });
+        same = same && visited == expected.size() && engine->size() == expected.size();
+    }
+    cout << checks << " random operations per engine, results " << (same ? "match" : "DIFFER") << " std::map" << endl;
+}
+
+void runBenchmarks(const string& only) {
+    vector<pair<string, void (*)()>> benchmarks = {
+        {"mementos", benchmarkMementos},
+        {"undolog", benchmarkUndoLog},
+        {"wal", benchmarkGroupCommit},
+        {"mvcc", benchmarkSnapshotIsolation},
+        {"engines", benchmarkStorageEngines},
+    };
+    for (auto& benchmark : benchmarks) {
+        if (only.empty() || only == benchmark.first) {
+            cout << "\n=== Benchmark: " << benchmark.first << " ===" << endl;
+            benchmark.second();
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    // "./main bench [name]" runs the benchmarks instead of the demo scenario
+    if (argc > 1 && string(argv[1]) == "bench") {
+        runBenchmarks(argc > 2 ? argv[2] : "");
+        return 0;
+    }
+    // "./main durable <log>" recovers the database from a write-ahead log, commits one
+    // more transaction to it and shows the records; run it twice to see recovery
+    if (argc > 2 && string(argv[1]) == "durable") {
+        try {
+            Database db;
+            WriteAheadLog log(argv[2]);
+            db.attachLog(&log);
+            UndoLogTransactionManager txManager;
+            txManager.beginTransaction(db);
+            db.insert("run" + to_string(db.size() + 1), "committed");
+            txManager.commitTransaction(db);
+            db.displayRecords();
+            return 0;
+        } catch (const exception& error) {
+            cout << error.what() << endl;
+            return 1;
+        }
+    }
+
     Database db;
     TransactionManager txManager;
    
@@ -152,6 +1843,65 @@ int main() {
     txManager.rollbackTransaction(db);
     
     db.displayRecords();
+
+    // Undo log transaction with a savepoint around a sub-step
+    UndoLogTransactionManager undoManager;
+    undoManager.beginTransaction(db);
+    db.update("user1", "Aditya Sharma");
+    undoManager.savepoint(db, "import");
+    db.insert("user3", "Saurav");
+    db.remove("user2");
+    
+    cout << "ERROR: Import step failed!" << endl;
+    undoManager.rollbackToSavepoint(db, "import");
+    db.insert("user4", "Manish");
+    undoManager.commitTransaction(db);
+
+    db.displayRecords();
+
+    // Rolling back the whole transaction
+    undoManager.beginTransaction(db);
+    db.remove("user4");
+    db.update("user2", "Rohit Kumar");
+    undoManager.rollbackTransaction(db);
+
+    db.displayRecords();
+
+    // The same transactions on a hash table engine
+    Database hashed(StorageEngineType::HASH);
+    undoManager.beginTransaction(hashed);
+    hashed.insert("user1", "Aditya");
+    hashed.insert("user2", "Rohit");
+    undoManager.savepoint(hashed, "extra");
+    hashed.insert("user3", "Saurav");
+    undoManager.rollbackToSavepoint(hashed, "extra");
+    undoManager.commitTransaction(hashed);
+
+    hashed.displayRecords();
+
+    // Snapshot isolation: readers see the database as of their start
+    cout << "=== SNAPSHOT ISOLATION ===" << endl;
+    VersionedDatabase versioned;
+    {
+        VersionedDatabase::Transaction setup(versioned);
+        setup.put("user1", "Aditya");
+        setup.put("user2", "Rohit");
+        setup.commit();
+    }
+    VersionedDatabase::Transaction reader(versioned);
+    VersionedDatabase::Transaction first(versioned);
+    VersionedDatabase::Transaction second(versioned);
+    first.put("user2", "Rohit Kumar");
+    second.put("user2", "Rohit Verma");
+    cout << "First writer commit: " << (first.commit() ? "committed" : "conflict, aborted") << endl;
+    cout << "Second writer commit: " << (second.commit() ? "committed" : "conflict, aborted") << endl;
+
+    string name;
+    reader.get("user2", name);
+    cout << "Reader that started before the commit sees user2 = " << name << endl;
+    VersionedDatabase::Transaction later(versioned);
+    later.get("user2", name);
+    cout << "Reader that started after it sees user2 = " << name << endl;
     
     return 0;
 }
\ No newline at end of file